@@ -1,11 +1,7 @@
-QT += core gui widgets network
+# Moteur (core), fenêtre de chat (app) et robots sans affichage (bots).
+TEMPLATE = subdirs
 
-TARGET = Chat
-TEMPLATE = app
+SUBDIRS = core app bots
 
-SOURCES += \
-  main.cpp \
-  Chat.cpp
-
-HEADERS += \
-  Chat.h
+app.depends = core
+bots.depends = core
@@ -1,154 +1,61 @@
+#include <QDateTime>
 #include <QMessageBox>
-#include "Chat.h"
+#include <QScrollBar>
+#include <QStatusBar>
+#include <QTextCursor>
+#include <algorithm>
+#include "ChatWindow.h"
 
-#include <iostream>
+// Caractères affichés d'un long message : au-delà, aperçu tronqué (la zone
+// de texte ne met pas en page plusieurs mégaoctets).
+static const int PREVIEW = 4096;
 
-////////////////////////////////////////////////////////////////////////////////
-// Chat ////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
-
-// Processeurs.
-const std::map<QString, Chat::Processor> Chat::PROCESSORS {
-    {"#alias",        &Chat::process_alias},
-    {"#connected",    &Chat::process_connected},
-    {"#disconnected", &Chat::process_disconnected},
-    {"#renamed",      &Chat::process_renamed},
-    {"#list",         &Chat::process_list},
-    {"#private",      &Chat::process_private},
-    {"#error",        &Chat::process_error}
-};
-
-// Constructeur.
-Chat::Chat (const QString & host, quint16 port, QObject * parent) :
-  QObject (parent),
-  socket ()
-{
-    // Signal "connected" émis lorsque la connexion est effectuée.
-    connect (&socket, &QTcpSocket::connected, [this, host, port] () {
-        emit connected (host, port);
-    });
-
-    // Signal "disconnected" émis lors d'une déconnexion du socket.
-    connect (&socket, &QTcpSocket::disconnected, this, &Chat::disconnected);
-
-    // Lecture.
-    connect (&socket, &QIODevice::readyRead, [this] () {
-        // Tant que l'on peut lire une ligne...
-        while (socket.canReadLine ())
-        {
-            // Lecture d'une ligne et suppression du "newline".
-            QString m = socket.readLine ().chopped (1);
-
-            // Flot de lecture.
-            QTextStream stream (&m);
-            // Lecture d'une commande potentielle.
-            QString command;
-            stream >> command;
-
-            // Recherche de la commande serveur dans le tableau associatif.
-            std::map<QString, Chat::Processor>::const_iterator it = PROCESSORS.find (command);
-
-            if (it != PROCESSORS.end ())
-            {
-                // - si elle existe, traitement du reste du message par le processeur.
-                Processor processor = it->second;
-                (this->*processor) (stream);
-            }
-            else
-            {
-                // - sinon, émission du signal "message" contenant la ligne entière.
-                emit message (m);
-            }
-        }
-    });
-
-    // CONNEXION !
-    socket.connectToHost (host, port, QIODevice::ReadWrite, QAbstractSocket::IPv4Protocol);
-}
-
-Chat::~Chat ()
-{
-    // Déconnexion des signaux.
-    socket.disconnect ();
-}
-
-// Commande "#alias"
-void Chat::process_alias (QTextStream & is)
-{
-    QString pseudo;
-    is >> pseudo;
-    emit alias (pseudo);
-}
-
-// Commande "#connected"
-void Chat::process_connected (QTextStream & is)
-{
-    QString pseudo;
-    is >> pseudo;
-    emit user_connected (pseudo);
-}
-
-// Commande "#disconnected"
-void Chat::process_disconnected (QTextStream & is)
-{
-    QString pseudo;
-    is >> pseudo;
-    emit user_disconnected (pseudo);
-}
-
-// Commande "#renamed"
-void Chat::process_renamed (QTextStream & is)
+static QString preview (const QString & message)
 {
-    QString oldPseudo, newPseudo;
-    is >> oldPseudo >> newPseudo;
-    emit user_renamed (oldPseudo, newPseudo);
+    if (message.size () <= PREVIEW)
+        return message;
+    return message.left (PREVIEW)
+         + QObject::tr("<em>... (%1 characters not shown)</em>").arg (message.size () - PREVIEW);
 }
 
-// Commande "#list"
-void Chat::process_list (QTextStream & is)
+// Message public : texte brut ajouté en fin de document (alias en gras),
+// sans l'analyse HTML ni la mise en page riche de QTextEdit::append.
+static void append_message (QTextEdit & text, const QString & sender, const QString & message)
 {
-    QStringList pseudos;
-    while (!is.atEnd ())
+    QScrollBar * bar = text.verticalScrollBar ();
+    bool bottom = bar->value () == bar->maximum ();
+
+    QTextCharFormat plain;
+    QTextCharFormat bold;
+    bold.setFontWeight (QFont::Bold);
+
+    QTextCursor cursor (text.document ());
+    cursor.movePosition (QTextCursor::End);
+    cursor.insertBlock (QTextBlockFormat (), plain);
+    cursor.insertText (sender, bold);
+    cursor.insertText (" : ", plain);
+    if (message.size () <= PREVIEW)
+        cursor.insertText (message, plain);
+    else
     {
-        QString pseudo;
-        is >> pseudo;
-        if (!pseudo.isEmpty()) {
-            pseudos << pseudo;
-        }
+        QTextCharFormat italic;
+        italic.setFontItalic (true);
+        cursor.insertText (message.left (PREVIEW), plain);
+        cursor.insertText (QObject::tr("... (%1 characters not shown)").arg (message.size () - PREVIEW), italic);
     }
-    emit user_list (pseudos);
-}
 
-// Commande "#private"
-void Chat::process_private (QTextStream & is)
-{
-    QString sender;
-    is >> sender;
-    QString msg = is.readAll ().trimmed ();
-    emit user_private (sender, msg);
-}
-
-// Commande "#error"
-void Chat::process_error (QTextStream & is)
-{
-    QString id;
-    is >> id >> Qt::ws;
-    emit error (id);
-}
-
-// Envoi d'un message à travers le socket.
-void Chat::write (const QString & message)
-{
-    socket.write (message.toUtf8 () + '\n');
+    // Défilement seulement si la fin était visible.
+    if (bottom)
+        bar->setValue (bar->maximum ());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // ChatWindow //////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-ChatWindow::ChatWindow (const QString & host, quint16 port, QWidget * parent) :
+ChatWindow::ChatWindow (const QString & host, quint16 port, bool secure, const QString & ca, QWidget * parent) :
     QMainWindow (parent),
-    chat (host, port, this),
+    chat (this),
     text (this),
     input (this),
     users(this)
@@ -196,7 +103,7 @@ ChatWindow::ChatWindow (const QString & host, quint16 port, QWidget * parent) :
 
         if (ok && !pseudo.isEmpty())
         {
-            chat.write (pseudo);
+            chat.login (pseudo);
 
             input.setEnabled (true);
             input.setFocus ();
@@ -213,7 +120,18 @@ ChatWindow::ChatWindow (const QString & host, quint16 port, QWidget * parent) :
 
     // Messages.
     connect (&chat, &Chat::message, [this] (const QString & message) {
-        text.append (message);
+        statusBar ()->clearMessage ();
+        text.append (preview (message));
+    });
+
+    connect (&chat, &Chat::user_message, [this] (const QString & sender, const QString & message) {
+        statusBar ()->clearMessage ();
+        append_message (text, sender, message);
+    });
+
+    // Long message en cours de réception : progression.
+    connect (&chat, &Chat::receiving, [this] (qint64 received, qint64 total) {
+        statusBar ()->showMessage (tr("Receiving a long message: %1 %").arg (100 * received / std::max<qint64> (total, 1)));
     });
 
     // Liste des utilisateurs.
@@ -222,7 +140,18 @@ ChatWindow::ChatWindow (const QString & host, quint16 port, QWidget * parent) :
     // Nouvel alias d'un utilisateur.
     // Message privé.
 
+    // Reconnexion automatique.
+    connect (&chat, &Chat::reconnecting, [this] (int delay) {
+        text.append (tr("<em>Reconnecting in %1 s...</em>").arg (delay / 1000.0, 0, 'f', 1));
+    });
+
+    connect (&chat, &Chat::resumed, [this] () {
+        input.setEnabled (true);
+        text.append (tr("<em>Session resumed.</em>"));
+    });
+
     connect (&chat, &Chat::alias, [this] (const QString & pseudo) {
+        input.setEnabled (true);
         this->setWindowTitle(pseudo);
         text.append (tr("<em>Alias validated: <strong>%1</strong></em>").arg(pseudo));
     });
@@ -238,6 +167,28 @@ ChatWindow::ChatWindow (const QString & host, quint16 port, QWidget * parent) :
         text.append (tr("<em>%1 has joined the chat.</em>").arg(pseudo));
     });
 
+    // Connexions / déconnexions regroupées : mise à jour de la liste en une
+    // seule passe, sans rafraîchissement intermédiaire.
+    connect (&chat, &Chat::user_presence, [this] (const QStringList & joined, const QStringList & left) {
+        users.setUpdatesEnabled (false);
+        for (const QString & pseudo : left)
+            qDeleteAll (users.findItems (pseudo, Qt::MatchExactly));
+        for (const QString & pseudo : joined)
+            if (users.findItems (pseudo, Qt::MatchExactly).isEmpty ())
+                users.addItem (pseudo);
+        users.setUpdatesEnabled (true);
+
+        // Au-delà de quelques noms, seul le nombre est affiché.
+        if (!joined.isEmpty ())
+            text.append (joined.size () <= 10
+                ? tr("<em>%1 joined the chat.</em>").arg (joined.join (", "))
+                : tr("<em>%1 users joined the chat.</em>").arg (joined.size ()));
+        if (!left.isEmpty ())
+            text.append (left.size () <= 10
+                ? tr("<em>%1 left.</em>").arg (left.join (", "))
+                : tr("<em>%1 users left.</em>").arg (left.size ()));
+    });
+
     connect (&chat, &Chat::user_disconnected, [this] (const QString & pseudo) {
         QList<QListWidgetItem *> items = users.findItems(pseudo, Qt::MatchExactly);
         qDeleteAll(items);
@@ -253,7 +204,24 @@ ChatWindow::ChatWindow (const QString & host, quint16 port, QWidget * parent) :
       });
 
     connect (&chat, &Chat::user_private, [this] (const QString & sender, const QString & message) {
-        text.append (tr("<font color='blue'>[Private from %1]: %2</font>").arg(sender, message));
+        statusBar ()->clearMessage ();
+        text.append (tr("<font color='blue'>[Private from %1]: %2</font>").arg(sender, preview (message)));
+    });
+
+    // Message privé en attente de la connexion du destinataire (la remise
+    // n'est pas affichée : c'est le cas normal).
+    connect (&chat, &Chat::private_queued, [this] (const QString & recipient) {
+        text.append (tr("<em>%1 is offline: message queued.</em>").arg(recipient));
+    });
+
+    // Résultats de recherche : date, auteur, texte brut.
+    connect (&chat, &Chat::search_result, [this] (qint64 time, const QString & sender, const QString & message) {
+        QString date = QDateTime::fromSecsSinceEpoch (time).toString ("dd/MM hh:mm");
+        text.append (tr("<font color='gray'>[%1] <b>%2</b> : %3</font>").arg (date, sender.toHtmlEscaped (), message.toHtmlEscaped ()));
+    });
+
+    connect (&chat, &Chat::search_done, [this] (int count) {
+        text.append (tr("<em>%n result(s).</em>", nullptr, count));
     });
 
     // Gestion des erreurs.
@@ -278,4 +246,7 @@ ChatWindow::ChatWindow (const QString & host, quint16 port, QWidget * parent) :
 
     // CONNEXION !
     text.append (tr("<b>Connecting...</b>"));
+    if (secure)
+        chat.secure (ca);
+    chat.open (host, port);
 }
@@ -0,0 +1,32 @@
+#ifndef CHATWINDOW_H
+#define CHATWINDOW_H
+
+#include <QMainWindow>
+#include <QTextEdit>
+#include <QLineEdit>
+#include <QDockWidget>
+#include <QInputDialog>
+#include <QListWidget>
+#include "Chat.h"
+
+// ChatWindow hérite de QMainWindow.
+class ChatWindow : public QMainWindow
+{
+  Q_OBJECT
+
+  private:
+    // Moteur de messagerie instantanée.
+    Chat chat;
+    // Zone de texte.
+    QTextEdit text;
+    // Zone de saisie.
+    QLineEdit input;
+
+    QListWidget users;
+
+  public:
+    // Constructeur ; "secure" : connexion TLS, "ca" : autorité de certification.
+    ChatWindow (const QString & host, quint16 port, bool secure = false, const QString & ca = QString (), QWidget * parent = nullptr);
+};
+
+#endif // CHATWINDOW_H
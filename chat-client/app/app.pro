@@ -0,0 +1,13 @@
+QT += core gui widgets network
+
+TARGET = Chat
+TEMPLATE = app
+
+include(../core/chatcore.pri)
+
+SOURCES += \
+  main.cpp \
+  ChatWindow.cpp
+
+HEADERS += \
+  ChatWindow.h
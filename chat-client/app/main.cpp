@@ -0,0 +1,25 @@
+#include <QApplication>
+#include "ChatWindow.h"
+
+int main (int argc, char * argv [])
+{
+    QApplication a (argc, argv);
+
+    QCoreApplication::setOrganizationName ("aassif");
+    QCoreApplication::setApplicationName ("chat");
+
+    // Serveur : "Chat [hôte] [port] [--tls [ca.pem]]" (par défaut
+    // 127.0.0.1:3101, en clair).
+    QStringList arguments = a.arguments ();
+    int tls = arguments.indexOf ("--tls");
+    QString ca = tls > 0 && arguments.size () > tls + 1 ? arguments[tls + 1] : QString ();
+    if (tls > 0)
+        arguments = arguments.mid (0, tls);
+    QString host = arguments.size () > 1 ? arguments[1] : QString ("127.0.0.1");
+    quint16 port = arguments.size () > 2 ? arguments[2].toUShort () : 3101;
+
+    ChatWindow w (host, port, tls > 0, ca);
+    w.show ();
+
+    return a.exec ();
+}
@@ -0,0 +1,12 @@
+# Robots : instances de Chat dans une QCoreApplication, sans affichage.
+QT = core network
+
+TARGET = chat-bots
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../core/chatcore.pri)
+
+SOURCES += \
+  main.cpp
@@ -0,0 +1,215 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "Chat.h"
+
+// Robots : nombreuses instances de Chat dans une seule boucle d'événements,
+// sans affichage. Deux modes, résultat en une ligne JSON :
+// - charge : connexion, alias, messages horodatés, latence de remise
+//   (même format de message que loadgen côté serveur) ;
+// - analyse ("--parse") : débit d'analyse des lignes reçues et mémoire par
+//   instance, sans connexion.
+
+// Mémoire résidente du processus (Linux, pages de 4 Kio), 0 ailleurs.
+static qint64 resident ()
+{
+    QFile file ("/proc/self/statm");
+    if (!file.open (QIODevice::ReadOnly)) return 0;
+    QList<QByteArray> fields = file.readAll ().split (' ');
+    return fields.size () > 1 ? fields[1].toLongLong () * 4096 : 0;
+}
+
+// Horloge monotone (nanosecondes), comparable à celle de loadgen.
+static qint64 now ()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+// Compteurs de la charge.
+struct Stats
+{
+    quint64 sent = 0;
+    quint64 received = 0;
+    quint64 errors = 0;
+    int logged = 0;
+    qint64 memory = 0;
+    std::vector<qint64> latencies;
+};
+
+static qint64 percentile (std::vector<qint64> & values, double p)
+{
+    if (values.empty ()) return 0;
+    std::size_t rank = std::min (values.size () - 1, static_cast<std::size_t> (p * values.size ()));
+    std::nth_element (values.begin (), values.begin () + rank, values.end ());
+    return values[rank];
+}
+
+// Charge : "clients" robots, "rate" messages par seconde chacun.
+static int load (QCoreApplication & app, const QString & host, quint16 port, bool secure, const QString & ca, const QStringList & events,
+                 int clients, double rate, double duration)
+{
+    Stats stats;
+    qint64 before = resident ();
+    QString prefix = QString ("qbot%1_").arg (QCoreApplication::applicationPid ());
+    std::vector<QTimer *> timers;
+
+    for (int i = 0; i < clients; ++i)
+    {
+        Chat * chat = new Chat (&app);
+        QString alias = prefix + QString::number (i);
+        QTimer * timer = new QTimer (chat);
+        timer->setInterval (static_cast<int> (1000.0 / rate));
+        timers.push_back (timer);
+
+        QObject::connect (chat, &Chat::connected, [chat, alias] () {
+            chat->login (alias);
+        });
+
+        // Alias validé : envoi périodique, départ décalé pour lisser la charge.
+        QObject::connect (chat, &Chat::alias, [&stats, &before, clients, timer] () {
+            if (++stats.logged == clients)
+            {
+                stats.memory = (resident () - before) / clients;
+                std::cerr << "chat-bots: " << clients << " clients connectés" << std::endl;
+            }
+            QTimer::singleShot (QRandomGenerator::global ()->bounded (timer->interval () + 1), timer, qOverload<> (&QTimer::start));
+        });
+
+        QObject::connect (timer, &QTimer::timeout, [chat, &stats] () {
+            chat->write ("msg ts=" + QString::number (now ()));
+            ++stats.sent;
+        });
+
+        // Message horodaté : "... ts=<ns>".
+        auto timestamped = [&stats] (const QString & m) {
+            int ts = m.indexOf (" ts=");
+            if (ts < 0) return;
+            qint64 sent = m.mid (ts + 4).section (' ', 0, 0).toLongLong ();
+            stats.latencies.push_back (std::max<qint64> (now () - sent, 0) / 1000);
+            ++stats.received;
+        };
+        QObject::connect (chat, &Chat::message, timestamped);
+        QObject::connect (chat, &Chat::user_message, [timestamped] (const QString &, const QString & m) {
+            timestamped (m);
+        });
+
+        QObject::connect (chat, &Chat::error, [&stats] () {
+            ++stats.errors;
+        });
+
+        if (!events.isEmpty ())
+            chat->subscribe (events);
+        if (secure)
+            chat->secure (ca);
+        chat->open (host, port);
+    }
+
+    // Fin de l'envoi, puis une seconde pour vider les files.
+    QTimer::singleShot (static_cast<int> (duration * 1000), [&timers] () {
+        for (QTimer * timer : timers) timer->stop ();
+    });
+    QTimer::singleShot (static_cast<int> ((duration + 1.0) * 1000), [&app] () {
+        app.quit ();
+    });
+
+    QElapsedTimer elapsed;
+    elapsed.start ();
+    app.exec ();
+
+    std::cout << "{\"clients\":" << clients
+              << ",\"logged\":" << stats.logged
+              << ",\"sent\":" << stats.sent
+              << ",\"received\":" << stats.received
+              << ",\"errors\":" << stats.errors
+              << ",\"elapsed_s\":" << elapsed.elapsed () / 1000.0
+              << ",\"delivered_per_s\":" << stats.received / duration
+              << ",\"p50_us\":" << percentile (stats.latencies, 0.50)
+              << ",\"p99_us\":" << percentile (stats.latencies, 0.99)
+              << ",\"bytes_per_client\":" << stats.memory
+              << "}" << std::endl;
+    return 0;
+}
+
+// Analyse : "count" lignes représentatives traitées par une instance non
+// connectée, puis mémoire de 10 000 instances.
+static int parse (int count)
+{
+    const QStringList lines {
+        "#users 1:alice 2:bob 3:carol",
+        "#msg 1 bonjour tout le monde",
+        "#msg 2 bonjour tout le monde",
+        "#msg 3:carol bonjour tout le monde",
+        "#connected bob",
+        "#disconnected bob",
+        "#presence +carol +dave -erin",
+        "#private alice un message privé",
+        "#list alice bob carol dave erin frank",
+        "#renamed bob robert",
+        "#delivered alice"
+    };
+
+    Chat chat;
+    quint64 emitted = 0;
+    QObject::connect (&chat, &Chat::message, [&emitted] (const QString &) { ++emitted; });
+    QObject::connect (&chat, &Chat::user_message, [&emitted] (const QString &, const QString &) { ++emitted; });
+
+    QElapsedTimer timer;
+    timer.start ();
+    for (int i = 0; i < count; ++i)
+        chat.process (lines[i % lines.size ()]);
+    qint64 ns = timer.nsecsElapsed ();
+
+    const int INSTANCES = 10000;
+    qint64 before = resident ();
+    std::vector<std::unique_ptr<Chat>> chats;
+    for (int i = 0; i < INSTANCES; ++i)
+        chats.push_back (std::make_unique<Chat> ());
+    qint64 memory = (resident () - before) / INSTANCES;
+
+    std::cout << "{\"lines\":" << count
+              << ",\"messages\":" << emitted
+              << ",\"ns_per_line\":" << static_cast<double> (ns) / count
+              << ",\"bytes_per_instance\":" << memory
+              << "}" << std::endl;
+    return 0;
+}
+
+int main (int argc, char * argv [])
+{
+    QCoreApplication app (argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription ("Robots de chat sans affichage (charge ou analyse).");
+    parser.addHelpOption ();
+    parser.addOptions ({
+        {"host", "Serveur.", "hôte", "127.0.0.1"},
+        {"port", "Port du serveur.", "port", "3101"},
+        {"clients", "Nombre de robots.", "n", "100"},
+        {"rate", "Messages par seconde et par robot.", "msg/s", "1"},
+        {"duration", "Durée de l'envoi (secondes).", "s", "10"},
+        {"tls", "Connexions TLS."},
+        {"ca", "Autorité de certification du serveur (TLS).", "pem"},
+        {"events", "Événements reçus (messages,presence,renames ; par défaut tous).", "liste"},
+        {"parse", "Banc d'essai de l'analyse : nombre de lignes.", "n"}
+    });
+    parser.process (app);
+
+    if (parser.isSet ("parse"))
+        return parse (std::max (1, parser.value ("parse").toInt ()));
+
+    int clients = parser.value ("clients").toInt ();
+    double rate = parser.value ("rate").toDouble ();
+    if (clients <= 0 || rate <= 0.0)
+        parser.showHelp (1);
+
+    return load (app, parser.value ("host"), parser.value ("port").toUShort (), parser.isSet ("tls"), parser.value ("ca"),
+                 parser.value ("events").split (',', Qt::SkipEmptyParts), clients, rate, parser.value ("duration").toDouble ());
+}
@@ -0,0 +1,459 @@
+#include <QRandomGenerator>
+#include "Chat.h"
+
+#include <algorithm>
+#include <iostream>
+
+////////////////////////////////////////////////////////////////////////////////
+// Chat ////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Processeurs.
+const std::map<QString, Chat::Processor> Chat::PROCESSORS {
+    {"#alias",        &Chat::process_alias},
+    {"#connected",    &Chat::process_connected},
+    {"#disconnected", &Chat::process_disconnected},
+    {"#renamed",      &Chat::process_renamed},
+    {"#list",         &Chat::process_list},
+    {"#users",        &Chat::process_users},
+    {"#msg",          &Chat::process_msg},
+    {"#presence",     &Chat::process_presence},
+    {"#session",      &Chat::process_session},
+    {"#resumed",      &Chat::process_resumed},
+    {"#private",      &Chat::process_private},
+    {"#delivered",    &Chat::process_delivered},
+    {"#queued",       &Chat::process_queued},
+    {"#found",        &Chat::process_found},
+    {"#search",       &Chat::process_search},
+    {"#fragment",     &Chat::process_fragment},
+    {"#subscribed",   &Chat::process_subscribed},
+    {"#error",        &Chat::process_error}
+};
+
+// Constructeurs.
+Chat::Chat (const QString & host, quint16 port, QObject * parent) :
+  Chat (parent)
+{
+    open (host, port);
+}
+
+Chat::Chat (QObject * parent) :
+  QObject (parent),
+  socket (),
+  host_name (),
+  host_port (0),
+  secured (false),
+  ticket (),
+  pseudo (),
+  token (),
+  events (),
+  sequence (0),
+  logged (false),
+  quitting (false),
+  attempts (0),
+  retry (),
+  fragments (),
+  users ()
+{
+    // Connexion effectuée (TLS : une fois la poignée de main terminée).
+    connect (&socket, &QTcpSocket::connected, [this] () {
+        if (!secured)
+            established ();
+    });
+    connect (&socket, &QSslSocket::encrypted, this, &Chat::established);
+
+    // Ticket TLS reçu : conservé pour la prochaine connexion.
+    connect (&socket, &QSslSocket::newSessionTicketReceived, [this] () {
+        ticket = socket.sslConfiguration ().sessionTicket ();
+    });
+
+    // Signal "disconnected" émis lors d'une déconnexion du socket, puis
+    // reconnexion (sauf départ volontaire).
+    connect (&socket, &QTcpSocket::disconnected, [this] () {
+        logged = false;
+        emit disconnected ();
+        reconnect ();
+    });
+
+    // Échec d'une tentative de connexion (pas de signal "disconnected").
+    connect (&socket, &QAbstractSocket::errorOccurred, [this] (QAbstractSocket::SocketError) {
+        if (socket.state () == QAbstractSocket::UnconnectedState)
+            reconnect ();
+    });
+
+    retry.setSingleShot (true);
+    connect (&retry, &QTimer::timeout, this, &Chat::dial);
+
+    // Lecture.
+    connect (&socket, &QIODevice::readyRead, [this] () {
+        // Tant que l'on peut lire une ligne...
+        while (socket.canReadLine ())
+        {
+            // Lecture d'une ligne et suppression du "newline".
+            process (socket.readLine ().chopped (1));
+        }
+    });
+}
+
+void Chat::secure (const QString & ca)
+{
+    secured = true;
+
+    // Reprise de session : tickets exposés par Qt.
+    QSslConfiguration configuration = socket.sslConfiguration ();
+    configuration.setSslOption (QSsl::SslOptionDisableSessionPersistence, false);
+    if (!ca.isEmpty ())
+        configuration.addCaCertificates (ca);
+    socket.setSslConfiguration (configuration);
+}
+
+void Chat::open (const QString & host, quint16 port)
+{
+    host_name = host;
+    host_port = port;
+    quitting = false;
+
+    // CONNEXION !
+    dial ();
+}
+
+void Chat::login (const QString & alias)
+{
+    pseudo = alias;
+    QString line = "/session " + alias;
+    if (!events.isEmpty ())
+        line += " " + events;
+    socket.write (line.toUtf8 () + '\n');
+}
+
+void Chat::subscribe (const QStringList & names)
+{
+    events = names.join (',');
+    if (logged)
+        socket.write (("/subscribe " + events).toUtf8 () + '\n');
+}
+
+void Chat::close ()
+{
+    quitting = true;
+    retry.stop ();
+    socket.disconnectFromHost ();
+}
+
+void Chat::process (const QString & m)
+{
+    // Numéro de la trame (reprise de session).
+    ++sequence;
+
+    dispatch (m);
+}
+
+void Chat::dispatch (const QString & m)
+{
+    // Flot de lecture.
+    QString line = m;
+    QTextStream stream (&line);
+    // Lecture d'une commande potentielle.
+    QString command;
+    stream >> command;
+
+    // Recherche de la commande serveur dans le tableau associatif.
+    std::map<QString, Chat::Processor>::const_iterator it = PROCESSORS.find (command);
+
+    if (it != PROCESSORS.end ())
+    {
+        // - si elle existe, traitement du reste du message par le processeur.
+        Processor processor = it->second;
+        (this->*processor) (stream);
+    }
+    else
+    {
+        // - sinon, émission du signal "message" contenant la ligne entière.
+        emit message (m);
+    }
+}
+
+Chat::~Chat ()
+{
+    // Déconnexion des signaux.
+    socket.disconnect ();
+}
+
+// Connexion (ou reconnexion), TLS avec le dernier ticket s'il y en a un.
+void Chat::dial ()
+{
+    if (!secured)
+    {
+        socket.connectToHost (host_name, host_port, QIODevice::ReadWrite, QAbstractSocket::IPv4Protocol);
+        return;
+    }
+
+    if (!ticket.isEmpty ())
+    {
+        QSslConfiguration configuration = socket.sslConfiguration ();
+        configuration.setSessionTicket (ticket);
+        socket.setSslConfiguration (configuration);
+    }
+    socket.connectToHostEncrypted (host_name, host_port, QIODevice::ReadWrite, QAbstractSocket::IPv4Protocol);
+}
+
+// Connexion établie.
+// - reprise de la session, s'il y en a une ;
+// - sinon, nouvelle connexion avec l'alias déjà choisi ;
+// - sinon (première connexion), signal "connected".
+void Chat::established ()
+{
+    if (!token.isEmpty ())
+        socket.write (QString ("/resume %1 %2\n").arg (token).arg (sequence).toUtf8 ());
+    else if (!pseudo.isEmpty ())
+        login (pseudo);
+    else
+        emit connected (host_name, host_port);
+}
+
+// Reconnexion différée.
+void Chat::reconnect ()
+{
+    if (quitting || retry.isActive ()) return;
+
+    // Attente exponentielle (250 ms, 500 ms... 30 s) avec gigue : les clients
+    // coupés en même temps ne reviennent pas en même temps.
+    int delay = std::min (250 << std::min (attempts, 7), 30000);
+    delay = delay / 2 + QRandomGenerator::global ()->bounded (delay / 2 + 1);
+    ++attempts;
+
+    retry.start (delay);
+    emit reconnecting (delay);
+}
+
+// Commande "#alias"
+void Chat::process_alias (QTextStream & is)
+{
+    is >> pseudo;
+    logged = true;
+    attempts = 0;
+    emit alias (pseudo);
+}
+
+// Commande "#session" : jeton de reprise, début de la numérotation.
+void Chat::process_session (QTextStream & is)
+{
+    is >> token;
+    sequence = 0;
+    fragments.clear ();
+    users.clear ();
+}
+
+// Commande "#resumed" : session reprise, trames manquées à suivre.
+void Chat::process_resumed (QTextStream &)
+{
+    logged = true;
+    attempts = 0;
+    emit resumed ();
+}
+
+// Commande "#connected"
+void Chat::process_connected (QTextStream & is)
+{
+    QString pseudo;
+    is >> pseudo;
+    emit user_connected (pseudo);
+}
+
+// Commande "#disconnected"
+void Chat::process_disconnected (QTextStream & is)
+{
+    QString pseudo;
+    is >> pseudo;
+    emit user_disconnected (pseudo);
+}
+
+// Commande "#renamed"
+void Chat::process_renamed (QTextStream & is)
+{
+    QString oldPseudo, newPseudo;
+    is >> oldPseudo >> newPseudo;
+    emit user_renamed (oldPseudo, newPseudo);
+}
+
+// Commande "#list"
+void Chat::process_list (QTextStream & is)
+{
+    QStringList pseudos;
+    while (!is.atEnd ())
+    {
+        QString pseudo;
+        is >> pseudo;
+        if (!pseudo.isEmpty()) {
+            pseudos << pseudo;
+        }
+    }
+    emit user_list (pseudos);
+}
+
+// Commande "#users" : "<numéro>:<alias>..." (":<alias>" : autre nœud, sans
+// numéro). Liste complète des alias ; les numéros appris entre-temps
+// (présentations reçues pendant une liste fragmentée) sont plus récents
+// et conservés.
+void Chat::process_users (QTextStream & is)
+{
+    QStringList pseudos;
+    while (!is.atEnd ())
+    {
+        QString entry;
+        is >> entry;
+        int colon = entry.indexOf (':');
+        if (colon < 0) continue;
+        QString pseudo = entry.mid (colon + 1);
+        if (colon > 0 && !users.contains (entry.left (colon).toUInt ()))
+            users.insert (entry.left (colon).toUInt (), pseudo);
+        pseudos << pseudo;
+    }
+    emit user_list (pseudos);
+}
+
+// Commande "#msg" : "<numéro> <texte>", "<numéro>:<alias> <texte>"
+// (présentation d'un numéro) ou ":<alias> <texte>" (autre nœud).
+void Chat::process_msg (QTextStream & is)
+{
+    QString sender;
+    is >> sender;
+    // Un seul espace avant le texte, conservé tel quel.
+    QString text = is.readAll ().mid (1);
+
+    int colon = sender.indexOf (':');
+    if (colon < 0)
+        sender = users.value (sender.toUInt (), "?");
+    else
+    {
+        QString pseudo = sender.mid (colon + 1);
+        if (colon > 0)
+            users.insert (sender.left (colon).toUInt (), pseudo);
+        sender = pseudo;
+    }
+    emit user_message (sender, text);
+}
+
+// Commande "#presence" : "+pseudo" connecté, "-pseudo" déconnecté.
+void Chat::process_presence (QTextStream & is)
+{
+    QStringList joined, left;
+    while (!is.atEnd ())
+    {
+        QString change;
+        is >> change;
+        if (change.size () < 2) continue;
+        if (change[0] == '+')
+            joined << change.mid (1);
+        else if (change[0] == '-')
+            left << change.mid (1);
+    }
+    emit user_presence (joined, left);
+}
+
+// Commande "#private"
+void Chat::process_private (QTextStream & is)
+{
+    QString sender;
+    is >> sender;
+    QString msg = is.readAll ().trimmed ();
+    emit user_private (sender, msg);
+}
+
+// Commande "#delivered"
+void Chat::process_delivered (QTextStream & is)
+{
+    QString recipient;
+    is >> recipient;
+    emit private_delivered (recipient);
+}
+
+// Commande "#queued"
+void Chat::process_queued (QTextStream & is)
+{
+    QString recipient;
+    is >> recipient;
+    emit private_queued (recipient);
+}
+
+// Commande "#found"
+void Chat::process_found (QTextStream & is)
+{
+    qint64 time;
+    QString sender;
+    is >> time >> sender;
+    QString msg = is.readAll ().trimmed ();
+    emit search_result (time, sender, msg);
+}
+
+// Commande "#search"
+void Chat::process_search (QTextStream & is)
+{
+    int count;
+    is >> count;
+    emit search_done (count);
+}
+
+// Commande "#fragment" : "<numéro> <octets restants> <texte>". Texte ajouté
+// au message en cours ; dernier fragment : traitement du message complet.
+void Chat::process_fragment (QTextStream & is)
+{
+    quint32 id;
+    qint64 remaining;
+    is >> id >> remaining;
+    // Un seul espace avant le texte, conservé tel quel.
+    QString & text = fragments[id];
+    text += is.readAll ().mid (1);
+
+    if (remaining > 0)
+    {
+        emit receiving (text.size (), text.size () + remaining);
+        return;
+    }
+
+    QString complete;
+    complete.swap (text);
+    fragments.erase (id);
+    dispatch (complete);
+}
+
+// Commande "#subscribed"
+void Chat::process_subscribed (QTextStream & is)
+{
+    QString names;
+    is >> names;
+    emit subscribed (names.split (',', Qt::SkipEmptyParts));
+}
+
+// Commande "#error"
+void Chat::process_error (QTextStream & is)
+{
+    QString id;
+    is >> id >> Qt::ws;
+
+    // Session expirée : nouvelle connexion avec le même alias.
+    if (id == "invalid_session")
+    {
+        token.clear ();
+        login (pseudo);
+        return;
+    }
+
+    emit error (id);
+}
+
+// Envoi d'un message à travers le socket.
+void Chat::write (const QString & message)
+{
+    // Alias pas encore validé : la ligne est l'alias demandé.
+    if (!logged)
+    {
+        login (message);
+        return;
+    }
+
+    if (message.trimmed () == "/quit")
+        quitting = true;
+
+    socket.write (message.toUtf8 () + '\n');
+}
@@ -0,0 +1,141 @@
+#ifndef CHAT_H
+#define CHAT_H
+
+#include <map>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QSslSocket>
+#include <QTextStream>
+#include <QTimer>
+
+// Moteur de messagerie instantanée, sans interface graphique (bibliothèque
+// "chatcore") : utilisable par la fenêtre de chat comme par des robots dans
+// une QCoreApplication. API asynchrone : commandes, puis signaux.
+// Chat hérite de QObject
+class Chat : public QObject
+{
+  Q_OBJECT // signaux + slots
+
+  private:
+    // Signature d'une méthode dédiée au traitement d'un type de message.
+    typedef void (Chat::*Processor) (QTextStream &);
+    // Tableau associatif statique qui associe une chaîne de caractères à un processeur.
+    static const std::map<QString, Processor> PROCESSORS;
+    void process_alias (QTextStream &);
+    void process_connected (QTextStream &);
+    void process_disconnected (QTextStream &);
+    void process_renamed (QTextStream &);
+    void process_list (QTextStream &);
+    void process_users (QTextStream &);
+    void process_msg (QTextStream &);
+    void process_presence (QTextStream &);
+    void process_session (QTextStream &);
+    void process_resumed (QTextStream &);
+    void process_private (QTextStream &);
+    void process_delivered (QTextStream &);
+    void process_queued (QTextStream &);
+    void process_found (QTextStream &);
+    void process_search (QTextStream &);
+    void process_fragment (QTextStream &);
+    void process_subscribed (QTextStream &);
+    // Traitement d'une ligne (complète ou reconstituée), sans numérotation.
+    void dispatch (const QString & message);
+
+  private:
+    QSslSocket socket;
+    QString host_name;
+    quint16 host_port;
+    // TLS : connexions chiffrées, ticket de la dernière session (reprise
+    // sans poignée de main complète lors d'une reconnexion).
+    bool secured;
+    QByteArray ticket;
+
+    // Reprise de session : alias, jeton, nombre de trames reçues depuis
+    // "#session", alias validé, départ volontaire, tentatives de reconnexion.
+    QString pseudo;
+    QString token;
+    // Abonnements déclarés (vide : tous les événements).
+    QString events;
+    quint64 sequence;
+    bool logged;
+    bool quitting;
+    int attempts;
+    QTimer retry;
+
+    // Longs messages en cours de réception ("#fragment"), par numéro.
+    std::map<quint32, QString> fragments;
+    // Alias des expéditeurs de "#msg" par numéro ("#users", présentations).
+    QHash<quint32, QString> users;
+
+  private:
+    // Connexion (en clair ou TLS) ; connexion établie.
+    void dial ();
+    void established ();
+    // Reconnexion différée (attente exponentielle avec gigue).
+    void reconnect ();
+
+  private:
+    // Gestion des erreurs.
+    void process_error (QTextStream &);
+
+  public:
+    // constructeur sans connexion (voir "open").
+    Chat (QObject * parent = nullptr);
+    // constructeur : nom du serveur, port et, éventuellement, objet parent.
+    Chat (const QString & host, quint16 port, QObject * parent = nullptr);
+    ~Chat ();
+
+    // Chiffrement TLS des connexions suivantes (avant "open") ; "ca" :
+    // certificat(s) d'autorité acceptés en plus de ceux du système.
+    void secure (const QString & ca = QString ());
+    // Connexion au serveur (signal "connected").
+    void open (const QString & host, quint16 port);
+    // Choix de l'alias (signal "alias" une fois validé).
+    void login (const QString & pseudo);
+    // Événements diffusés reçus ("messages", "presence", "renames", "all",
+    // "none") : déclarés à la connexion, ou aussitôt si elle est établie.
+    void subscribe (const QStringList & events);
+    // Départ volontaire, sans reconnexion.
+    void close ();
+    // Envoi d'un message.
+    void write (const QString &);
+    // Traitement d'une ligne reçue (hors connexion : bancs d'essai).
+    void process (const QString & message);
+
+  signals:
+    // Connexion / déconnexion.
+    void connected (const QString & host, quint16 port);
+    void disconnected ();
+    // Reconnexion dans "delay" millisecondes ; session reprise.
+    void reconnecting (int delay);
+    void resumed ();
+    // Ligne non reconnue (affichée telle quelle).
+    void message (const QString & message);
+    // Message public : expéditeur, texte brut (mise en forme par l'interface).
+    void user_message (const QString & sender, const QString & message);
+    // Error.
+    void error (const QString & id);
+
+    void alias (const QString & pseudo);
+    void user_connected (const QString & pseudo);
+    void user_disconnected (const QString & pseudo);
+    void user_renamed (const QString & oldPseudo, const QString & newPseudo);
+    void user_list (const QStringList & pseudos);
+    // Connexions et déconnexions regroupées.
+    void user_presence (const QStringList & joined, const QStringList & left);
+    void user_private (const QString & sender, const QString & message);
+    // Accusés des messages privés : remis, ou en attente du destinataire.
+    void private_delivered (const QString & recipient);
+    void private_queued (const QString & recipient);
+    // Résultat de "/search" (date en secondes depuis 1970), fin des résultats.
+    void search_result (qint64 time, const QString & sender, const QString & message);
+    void search_done (int count);
+    // Long message en cours de réception : caractères reçus, total estimé.
+    void receiving (qint64 received, qint64 total);
+    // Abonnements confirmés par "/subscribe".
+    void subscribed (const QStringList & events);
+};
+
+#endif // CHAT_H
+
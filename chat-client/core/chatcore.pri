@@ -0,0 +1,12 @@
+# Édition de liens avec la bibliothèque "chatcore" (projets app et bots).
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+win32:CONFIG(release, debug|release): CHATCORE = $$OUT_PWD/../core/release
+else:win32:CONFIG(debug, debug|release): CHATCORE = $$OUT_PWD/../core/debug
+else: CHATCORE = $$OUT_PWD/../core
+
+LIBS += -L$$CHATCORE -lchatcore
+win32-g++: PRE_TARGETDEPS += $$CHATCORE/libchatcore.a
+else:win32: PRE_TARGETDEPS += $$CHATCORE/chatcore.lib
+else: PRE_TARGETDEPS += $$CHATCORE/libchatcore.a
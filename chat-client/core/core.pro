@@ -0,0 +1,12 @@
+# Moteur de messagerie (bibliothèque statique, sans interface graphique).
+QT = core network
+
+TARGET = chatcore
+TEMPLATE = lib
+CONFIG += staticlib
+
+SOURCES += \
+  Chat.cpp
+
+HEADERS += \
+  Chat.h
@@ -1,15 +0,0 @@
-#include <QApplication>
-#include "Chat.h"
-
-int main (int argc, char * argv [])
-{
-    QApplication a (argc, argv);
-
-    QCoreApplication::setOrganizationName ("aassif");
-    QCoreApplication::setApplicationName ("chat");
-
-    ChatWindow w ("127.0.0.1", 3101);
-    w.show ();
-
-    return a.exec ();
-}
@@ -0,0 +1,207 @@
+#ifndef ADMISSION_HPP
+#define ADMISSION_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <asio.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+// Admission ///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Contrôle des connexions par adresse source : connexions ouvertes et débit
+// de connexion (seau percé : chaque connexion ajoute 1, le niveau baisse de
+// "rate" par seconde, refus au-delà de "burst"). Table à adressage ouvert
+// (sondage linéaire) de 24 octets par adresse ; les adresses sans connexion
+// dont le seau est vide sont oubliées quand la table se remplit.
+class Admission
+{
+  public:
+    enum Verdict { ADMITTED, TOO_MANY, TOO_FAST };
+
+    // Adresse source réduite à 64 bits (IPv4, ou préfixe /64 en IPv6) ;
+    // NONE : pas d'adresse (socket Unix, connexion en mémoire).
+    typedef std::uint64_t Key;
+    static constexpr Key NONE = ~Key {0};
+
+  private:
+    struct Entry
+    {
+      Key key;
+      // Niveau du seau à la date "stamp" (millisecondes).
+      float level;
+      std::uint32_t connections;
+      std::uint64_t stamp;
+    };
+
+    std::vector<Entry> m_entries;
+    std::size_t m_size;
+    // Connexions par adresse (0 : pas de limite), débit (connexions par
+    // seconde, 0 : pas de limite) et rafale admise.
+    std::uint32_t m_max_connections;
+    double m_rate;
+    double m_burst;
+
+    static std::size_t hash (Key);
+    std::size_t slot (Key) const;
+    float level (const Entry &, std::uint64_t now) const;
+    void insert (const Entry &);
+    void rebuild (std::uint64_t now);
+
+  public:
+    Admission (std::uint32_t max_connections, double rate, double burst);
+    bool enabled () const;
+    static Key key (const asio::ip::address &);
+    // Nouvelle connexion de "key" à la date "now" (comptée si admise) ;
+    // fermeture d'une connexion admise.
+    Verdict admit (Key, std::chrono::nanoseconds now);
+    void release (Key);
+    // Adresses suivies.
+    std::size_t size () const;
+
+  private:
+    static constexpr std::size_t MIN_ENTRIES = 1024;
+};
+
+inline Admission::Admission (std::uint32_t max_connections, double rate, double burst) :
+  m_entries {},
+  m_size {0},
+  m_max_connections {max_connections},
+  m_rate {rate},
+  m_burst {std::max (burst, 1.0)}
+{
+  if (enabled ())
+    m_entries.assign (MIN_ENTRIES, Entry {NONE, 0.0f, 0, 0});
+}
+
+inline bool Admission::enabled () const
+{
+  return m_max_connections != 0 || m_rate > 0.0;
+}
+
+inline Admission::Key Admission::key (const asio::ip::address & address)
+{
+  if (address.is_v4 ())
+    return address.to_v4 ().to_uint ();
+
+  asio::ip::address_v6 v6 = address.to_v6 ();
+  if (v6.is_v4_mapped ())
+    return asio::ip::make_address_v4 (asio::ip::v4_mapped, v6).to_uint ();
+
+  // Préfixe /64 : un hôte IPv6 dispose en général de tout le sous-réseau.
+  // Bit de poids fort forcé : pas de confusion avec une adresse IPv4.
+  asio::ip::address_v6::bytes_type bytes = v6.to_bytes ();
+  Key key = 0;
+  for (int i = 0; i < 8; ++i)
+    key = key << 8 | bytes [i];
+  key |= Key {1} << 63;
+  return key == NONE ? NONE - 1 : key;
+}
+
+inline std::size_t Admission::hash (Key key)
+{
+  // splitmix64 : adresses voisines dispersées dans la table.
+  key += 0x9e3779b97f4a7c15ull;
+  key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ull;
+  key = (key ^ (key >> 27)) * 0x94d049bb133111ebull;
+  return static_cast<std::size_t> (key ^ (key >> 31));
+}
+
+inline std::size_t Admission::slot (Key key) const
+{
+  std::size_t mask = m_entries.size () - 1;
+  std::size_t i = hash (key) & mask;
+  while (m_entries [i].key != key && m_entries [i].key != NONE)
+    i = (i + 1) & mask;
+  return i;
+}
+
+inline float Admission::level (const Entry & entry, std::uint64_t now) const
+{
+  double elapsed = static_cast<double> (now - std::min (now, entry.stamp)) / 1000.0;
+  return static_cast<float> (std::max (0.0, entry.level - elapsed * m_rate));
+}
+
+inline void Admission::insert (const Entry & entry)
+{
+  m_entries [slot (entry.key)] = entry;
+}
+
+inline void Admission::rebuild (std::uint64_t now)
+{
+  // Adresses oubliables retirées ; taille doublée si la table reste plus
+  // qu'à moitié pleine, divisée par deux si elle est presque vide.
+  std::vector<Entry> entries;
+  entries.reserve (m_size);
+  for (const Entry & entry : m_entries)
+  {
+    if (entry.key == NONE) continue;
+    Entry kept {entry.key, level (entry, now), entry.connections, now};
+    if (kept.connections != 0 || kept.level > 0.0f)
+      entries.push_back (kept);
+  }
+
+  std::size_t capacity = MIN_ENTRIES;
+  while (capacity < entries.size () * 4)
+    capacity *= 2;
+
+  m_entries.assign (capacity, Entry {NONE, 0.0f, 0, 0});
+  m_size = entries.size ();
+  for (const Entry & entry : entries)
+    insert (entry);
+}
+
+inline Admission::Verdict Admission::admit (Key key, std::chrono::nanoseconds time)
+{
+  if (! enabled () || key == NONE) return ADMITTED;
+
+  std::uint64_t now = static_cast<std::uint64_t> (std::chrono::duration_cast<std::chrono::milliseconds> (time).count ());
+  std::size_t i = slot (key);
+  Entry & entry = m_entries [i];
+
+  if (entry.key == NONE)
+  {
+    // Table plus qu'à moitié pleine : nettoyage (ou agrandissement) avant
+    // l'ajout, sondages courts.
+    if ((m_size + 1) * 2 > m_entries.size ())
+    {
+      rebuild (now);
+      return admit (key, time);
+    }
+    entry = Entry {key, 0.0f, 0, now};
+    ++m_size;
+  }
+
+  if (m_max_connections != 0 && entry.connections >= m_max_connections)
+    return TOO_MANY;
+
+  if (m_rate > 0.0)
+  {
+    float current = level (entry, now);
+    if (current + 1.0f > m_burst)
+      return TOO_FAST;
+    entry.level = current + 1.0f;
+    entry.stamp = now;
+  }
+
+  ++entry.connections;
+  return ADMITTED;
+}
+
+inline void Admission::release (Key key)
+{
+  if (! enabled () || key == NONE) return;
+
+  Entry & entry = m_entries [slot (key)];
+  if (entry.key == key && entry.connections != 0)
+    --entry.connections;
+}
+
+inline std::size_t Admission::size () const
+{
+  return m_size;
+}
+
+#endif // ADMISSION_HPP
@@ -0,0 +1,255 @@
+#ifndef AFFINITY_HPP
+#define AFFINITY_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Affinity ////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Placement des threads sur des CPU choisis ("0-3,8", syntaxe de taskset et
+// de /sys). Pas de politique mémoire explicite : la politique par défaut du
+// noyau alloue une page sur le nœud NUMA du CPU qui la touche en premier, un
+// thread fixé avant ses allocations garde donc sa mémoire sur son nœud.
+// Topologie lue dans /sys/devices/system/node (sans libnuma) ; Linux
+// seulement, ailleurs un placement demandé est une erreur.
+class Affinity
+{
+  public:
+    typedef std::vector<int> Cpus;
+    static constexpr int MAX_CPUS = 1024;
+
+    // "0-3,8,10-11" trié, sans doublon (vide : pas de placement) ;
+    // std::invalid_argument si la liste est mal formée.
+    static Cpus parse (const std::string &);
+    static std::string format (const Cpus &);
+    // CPU autorisés pour le processus (lus au premier appel, avant tout
+    // placement : un thread hérite du masque de son créateur), nœud d'un
+    // CPU (-1 : inconnu).
+    static Cpus allowed ();
+    static int node (int cpu);
+    static Cpus nodes (const Cpus &);
+    // Thread appelant, ou autre thread, fixé sur "cpus" (vide : rien à
+    // faire) ; std::runtime_error si un CPU n'est pas autorisé.
+    static void pin (const Cpus &);
+    static void pin (std::thread &, const Cpus &);
+    // CPU effectifs d'un thread (appelant par défaut) ; nœud de la page qui
+    // contient "address" (-1 : inconnu).
+    static Cpus current ();
+    static Cpus current (std::thread &);
+    static int page_node (const void * address);
+
+  private:
+#if defined(__linux__)
+    static void pin (pthread_t, const Cpus &);
+    static Cpus current (pthread_t);
+#endif
+};
+
+inline Affinity::Cpus Affinity::parse (const std::string & text)
+{
+  Cpus cpus;
+  std::size_t begin = 0;
+  while (begin < text.size ())
+  {
+    std::size_t end = text.find (',', begin);
+    if (end == std::string::npos) end = text.size ();
+    std::string range = text.substr (begin, end - begin);
+    std::size_t dash = range.find ('-');
+    if (range.empty () || range.find_first_not_of ("0123456789-") != std::string::npos)
+      throw std::invalid_argument ("liste de CPU invalide : " + text);
+
+    std::size_t used = 0;
+    int first = std::stoi (range, &used);
+    int last = first;
+    if (dash != std::string::npos)
+    {
+      std::string tail = range.substr (dash + 1);
+      std::size_t tail_used = 0;
+      last = std::stoi (tail, &tail_used);
+      used = dash + 1 + tail_used;
+    }
+    if (used != range.size () || first < 0 || last < first || last >= MAX_CPUS)
+      throw std::invalid_argument ("liste de CPU invalide : " + text);
+
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus.push_back (cpu);
+    begin = end + 1;
+  }
+
+  std::sort (cpus.begin (), cpus.end ());
+  cpus.erase (std::unique (cpus.begin (), cpus.end ()), cpus.end ());
+  return cpus;
+}
+
+inline std::string Affinity::format (const Cpus & cpus)
+{
+  // Suites consécutives regroupées : "0-3,8".
+  std::string text;
+  for (std::size_t i = 0; i < cpus.size (); )
+  {
+    std::size_t j = i;
+    while (j + 1 < cpus.size () && cpus [j + 1] == cpus [j] + 1)
+      ++j;
+    if (! text.empty ()) text += ',';
+    text += std::to_string (cpus [i]);
+    if (j != i)
+      text += '-' + std::to_string (cpus [j]);
+    i = j + 1;
+  }
+  return text.empty () ? "-" : text;
+}
+
+inline Affinity::Cpus Affinity::allowed ()
+{
+  static const Cpus cpus = []
+  {
+    Cpus cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO (&set);
+    if (::sched_getaffinity (0, sizeof (set), &set) == 0)
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET (cpu, &set))
+          cpus.push_back (cpu);
+#endif
+    return cpus;
+  } ();
+  return cpus;
+}
+
+inline int Affinity::node (int cpu)
+{
+#if defined(__linux__)
+  // Nœuds parcourus jusqu'au premier absent ; un nœud sans CPU (mémoire
+  // seule) a une liste vide.
+  for (int node = 0; ; ++node)
+  {
+    std::ifstream file {"/sys/devices/system/node/node" + std::to_string (node) + "/cpulist"};
+    if (! file) break;
+    std::string list;
+    std::getline (file, list);
+    if (list.empty ()) continue;
+    Cpus cpus = parse (list);
+    if (std::binary_search (cpus.begin (), cpus.end (), cpu))
+      return node;
+  }
+#else
+  (void) cpu;
+#endif
+  return -1;
+}
+
+inline Affinity::Cpus Affinity::nodes (const Cpus & cpus)
+{
+  Cpus nodes;
+  for (int cpu : cpus)
+    nodes.push_back (node (cpu));
+  std::sort (nodes.begin (), nodes.end ());
+  nodes.erase (std::unique (nodes.begin (), nodes.end ()), nodes.end ());
+  nodes.erase (std::remove (nodes.begin (), nodes.end (), -1), nodes.end ());
+  return nodes;
+}
+
+#if defined(__linux__)
+inline void Affinity::pin (pthread_t thread, const Cpus & cpus)
+{
+  if (cpus.empty ()) return;
+
+  Cpus available = allowed ();
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  for (int cpu : cpus)
+  {
+    if (! std::binary_search (available.begin (), available.end (), cpu))
+      throw std::runtime_error ("CPU " + std::to_string (cpu) + " hors de l'ensemble autorisé (" + format (available) + ")");
+    CPU_SET (cpu, &set);
+  }
+  int error = ::pthread_setaffinity_np (thread, sizeof (set), &set);
+  if (error != 0)
+    throw std::runtime_error ("placement impossible sur " + format (cpus) + " (errno " + std::to_string (error) + ")");
+}
+
+inline Affinity::Cpus Affinity::current (pthread_t thread)
+{
+  Cpus cpus;
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  if (::pthread_getaffinity_np (thread, sizeof (set), &set) == 0)
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      if (CPU_ISSET (cpu, &set))
+        cpus.push_back (cpu);
+  return cpus;
+}
+#endif
+
+inline void Affinity::pin (const Cpus & cpus)
+{
+#if defined(__linux__)
+  pin (::pthread_self (), cpus);
+#else
+  if (! cpus.empty ())
+    throw std::runtime_error ("placement des threads indisponible");
+#endif
+}
+
+inline void Affinity::pin (std::thread & thread, const Cpus & cpus)
+{
+#if defined(__linux__)
+  if (thread.joinable ())
+    pin (thread.native_handle (), cpus);
+#else
+  (void) thread;
+  if (! cpus.empty ())
+    throw std::runtime_error ("placement des threads indisponible");
+#endif
+}
+
+inline Affinity::Cpus Affinity::current ()
+{
+#if defined(__linux__)
+  return current (::pthread_self ());
+#else
+  return {};
+#endif
+}
+
+inline Affinity::Cpus Affinity::current (std::thread & thread)
+{
+#if defined(__linux__)
+  if (thread.joinable ())
+    return current (thread.native_handle ());
+#else
+  (void) thread;
+#endif
+  return {};
+}
+
+inline int Affinity::page_node (const void * address)
+{
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+  // get_mempolicy (MPOL_F_NODE | MPOL_F_ADDR) : nœud de la page (déjà
+  // touchée) qui contient l'adresse.
+  int node = -1;
+  if (::syscall (SYS_get_mempolicy, &node, nullptr, 0, address, MPOL_F_NODE | MPOL_F_ADDR) == 0)
+    return node;
+#else
+  (void) address;
+#endif
+  return -1;
+}
+
+#endif // AFFINITY_HPP
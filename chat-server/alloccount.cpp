@@ -0,0 +1,49 @@
+// Compteur d'allocations, chargé par LD_PRELOAD (Linux, glibc) :
+//
+//   LD_PRELOAD=./alloccount.so ./server.exe 3101
+//   kill -USR1 <pid>   # affiche le nombre d'allocations sur stderr
+//
+// Indépendant du code du serveur : permet de comparer deux révisions.
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+extern "C" void * __libc_malloc (std::size_t);
+extern "C" void * __libc_calloc (std::size_t, std::size_t);
+extern "C" void * __libc_realloc (void *, std::size_t);
+
+static std::atomic<unsigned long> allocations {0};
+
+extern "C" void * malloc (std::size_t size)
+{
+  allocations.fetch_add (1, std::memory_order_relaxed);
+  return __libc_malloc (size);
+}
+
+extern "C" void * calloc (std::size_t count, std::size_t size)
+{
+  allocations.fetch_add (1, std::memory_order_relaxed);
+  return __libc_calloc (count, size);
+}
+
+extern "C" void * realloc (void * pointer, std::size_t size)
+{
+  allocations.fetch_add (1, std::memory_order_relaxed);
+  return __libc_realloc (pointer, size);
+}
+
+// Affichage depuis le gestionnaire de signal : write uniquement.
+static void report (int)
+{
+  char line [64];
+  int n = std::snprintf (line, sizeof line, "allocations %lu\n", allocations.load ());
+  if (n > 0) ::write (STDERR_FILENO, line, n);
+}
+
+__attribute__ ((constructor)) static void install ()
+{
+  std::signal (SIGUSR1, report);
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Comparaison de deux exécutions de bench.exe (lignes JSON) : temps par
+# opération de chaque cas et rapport b/a (< 1 : plus rapide).
+#
+# Usage : ./bench-compare.sh <a.json> <b.json>
+# Exemple :
+#   ./bench.exe > a.json ; (modification) ; make bench ; ./bench.exe > b.json
+#   ./bench-compare.sh a.json b.json
+
+[ $# -eq 2 ] || { echo "Usage: bench-compare.sh <a.json> <b.json>" >&2; exit 1; }
+
+awk '
+  function field(line, key,    s) {
+    s = line
+    sub(".*\"" key "\":", "", s)
+    sub("[,}].*", "", s)
+    gsub("\"", "", s)
+    return s
+  }
+  FNR == NR { a[field($0, "name")] = field($0, "ns_per_op"); next }
+  {
+    name = field($0, "name"); b = field($0, "ns_per_op")
+    if (name in a)
+      printf "{\"name\":\"%s\",\"a_ns\":%g,\"b_ns\":%g,\"ratio\":%.3f}\n", name, a[name], b, b / a[name]
+  }
+' "$1" "$2"
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Abonnements : audience passive (aucun envoi) abonnée à tous les événements,
+# à la présence seulement ou à rien, pendant qu'un groupe actif discute.
+# Octets reçus par l'audience, temps CPU du serveur (jiffies) et débit /
+# latences du groupe actif.
+#
+# Usage : ./bench-events.sh [audience]
+# Prérequis : make server loadgen ; Linux (/proc).
+
+AUDIENCE=${1:-2000}
+ACTIVE=${ACTIVE:-100}
+RATE=${RATE:-10}
+DURATION=${DURATION:-10}
+PORT=3101
+
+ulimit -n 65536
+
+# Temps CPU (utilisateur + système) d'un processus.
+cpu ()
+{
+  awk '{ print $14 + $15 }' /proc/$1/stat
+}
+
+for events in all presence none
+do
+  ./server.exe $PORT > /dev/null 2>&1 &
+  SERVER=$!
+  sleep 1
+
+  ./loadgen.exe --clients $AUDIENCE --rate 0 --duration $((DURATION + 2)) --prefix passive_ --events $events 127.0.0.1:$PORT > /tmp/chat-audience.json &
+  AUDIENCE_PID=$!
+  sleep 1
+
+  BEFORE=$(cpu $SERVER)
+  RESULT=$(./loadgen.exe --clients $ACTIVE --rate $RATE --duration $DURATION --prefix active_ 127.0.0.1:$PORT)
+  AFTER=$(cpu $SERVER)
+  wait $AUDIENCE_PID
+
+  echo "{\"events\":\"$events\",\"audience\":$AUDIENCE,\"server_cpu_jiffies\":$((AFTER - BEFORE)),\"passive\":$(cat /tmp/chat-audience.json),\"active\":$RESULT}"
+
+  kill $SERVER
+  wait $SERVER 2> /dev/null
+done
+rm -f /tmp/chat-audience.json
@@ -0,0 +1,56 @@
+#!/bin/sh
+# Comparaison des backends epoll et io_uring : appels système par message
+# délivré et latence p99, pour un nombre croissant de connexions.
+#
+# Usage : ./bench-io.sh [connexions...]
+# Prérequis : make server server-uring loadgen ; perf pour compter les appels
+# système (sinon, seules les latences sont mesurées).
+#
+# Le débit total est fixe (RATE messages/s, tous clients confondus) : chaque
+# message est diffusé à toutes les connexions.
+
+CONNECTIONS=${*:-"1000 5000 10000"}
+RATE=${RATE:-20}
+DURATION=${DURATION:-10}
+PORT=3101
+
+ulimit -n 65536
+
+for backend in server.exe server-uring.exe
+do
+  [ -x ./$backend ] || continue
+
+  for n in $CONNECTIONS
+  do
+    ./$backend $PORT > /dev/null &
+    SERVER=$!
+    sleep 1
+
+    PERF=""
+    if command -v perf > /dev/null
+    then
+      perf stat -e raw_syscalls:sys_enter -x, -o perf.txt -p $SERVER &
+      PERF=$!
+    fi
+
+    RESULT=$(./loadgen.exe --clients $n --rate $(awk "BEGIN { print $RATE / $n }") --duration $DURATION 127.0.0.1:$PORT)
+
+    SYSCALLS=null
+    if [ -n "$PERF" ]
+    then
+      kill -INT $PERF
+      wait $PERF
+      SYSCALLS=$(grep raw_syscalls perf.txt | cut -d, -f1)
+    fi
+
+    kill $SERVER
+    wait $SERVER 2> /dev/null
+
+    RECEIVED=$(echo "$RESULT" | sed 's/.*"received":\([0-9]*\).*/\1/')
+    PER_MESSAGE=$(awk "BEGIN { if (\"$SYSCALLS\" == \"null\" || $RECEIVED == 0) print \"null\"; else print $SYSCALLS / $RECEIVED }")
+
+    echo "{\"backend\":\"$backend\",\"connections\":$n,\"syscalls\":$SYSCALLS,\"syscalls_per_message\":$PER_MESSAGE,\"loadgen\":$RESULT}"
+  done
+done
+
+rm -f perf.txt
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Comparaison de deux révisions du serveur (par défaut : la session par
+# rappels chaînés et la session coroutine) : débit délivré et allocations
+# par message délivré.
+#
+# Usage : ./bench-session.sh [révision-a] [révision-b]
+# Exemple : ./bench-session.sh HEAD~1 HEAD
+# Prérequis : ASIO dans ./asio-1.24.0 (ou variable ASIO), make loadgen alloccount.
+
+A=${1:-HEAD~1}
+B=${2:-HEAD}
+CLIENTS=${CLIENTS:-500}
+RATE=${RATE:-2}
+DURATION=${DURATION:-10}
+ASIO=${ASIO:-$(pwd)/asio-1.24.0}
+PORT=3101
+WORK=$(mktemp -d)
+
+ulimit -n 65536
+
+# Nettoyage des arbres de travail, y compris en cas d'échec.
+trap 'for tree in $WORK/*; do [ -d "$tree" ] && git worktree remove --force "$tree"; done; rm -rf $WORK' EXIT
+
+i=0
+for rev in $A $B
+do
+  i=$((i + 1))
+  TREE=$WORK/$i
+  git worktree add --detach $TREE $rev > /dev/null 2>&1 || exit 1
+  make -C $TREE/chat-server server ASIO=$ASIO > /dev/null || exit 1
+
+  LD_PRELOAD=./alloccount.so $TREE/chat-server/server.exe $PORT > /dev/null 2> $WORK/alloc.txt &
+  SERVER=$!
+  sleep 1
+
+  # Compteur avant et après la charge.
+  kill -USR1 $SERVER
+  sleep 0.2
+  RESULT=$(./loadgen.exe --clients $CLIENTS --rate $RATE --duration $DURATION 127.0.0.1:$PORT)
+  kill -USR1 $SERVER
+  sleep 0.2
+
+  kill $SERVER
+  wait $SERVER 2> /dev/null
+
+  BEFORE=$(grep allocations $WORK/alloc.txt | sed -n 1p | cut -d' ' -f2)
+  AFTER=$(grep allocations $WORK/alloc.txt | sed -n 2p | cut -d' ' -f2)
+  RECEIVED=$(echo "$RESULT" | sed 's/.*"received":\([0-9]*\).*/\1/')
+  PER_MESSAGE=$(awk "BEGIN { print $RECEIVED == 0 ? 0 : ($AFTER - $BEFORE) / $RECEIVED }")
+
+  echo "{\"revision\":\"$rev\",\"commit\":\"$(git rev-parse --short $rev)\",\"allocations\":$((AFTER - BEFORE)),\"allocations_per_message\":$PER_MESSAGE,\"loadgen\":$RESULT}"
+done
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Attente active du thread d'e/s : latences p50, p99, p99.9 à charge
+# identique, serveur ordinaire puis serveur en attente active (écarts p99 et
+# p99.9 par rapport au premier dans la ligne du second).
+#
+# Usage : ./bench-spin.sh [connexions...]
+# Variables : SPIN (µs avant blocage, 50), SOCKET_SPIN (SO_BUSY_POLL, µs ;
+# vide : non réglé), IO_CPUS (CPU du thread d'e/s, à isoler).
+# Prérequis : make server loadgen.
+
+CONNECTIONS=${*:-"100 1000"}
+RATE=${RATE:-10}
+DURATION=${DURATION:-10}
+PORT=3101
+SPIN=${SPIN:-50}
+BASE=$(mktemp)
+
+ulimit -n 65536
+
+OPTIONS=
+[ -n "$IO_CPUS" ] && OPTIONS="$OPTIONS --io-cpus $IO_CPUS"
+SPIN_OPTIONS="$OPTIONS --busy-poll $SPIN"
+[ -n "$SOCKET_SPIN" ] && SPIN_OPTIONS="$SPIN_OPTIONS --socket-busy-poll $SOCKET_SPIN"
+
+for n in $CONNECTIONS
+do
+  for mode in block spin
+  do
+    if [ $mode = block ]
+    then
+      ./server.exe $PORT $OPTIONS > /dev/null 2>&1 &
+    else
+      ./server.exe $PORT $SPIN_OPTIONS > /dev/null 2>&1 &
+    fi
+    SERVER=$!
+    sleep 1
+
+    if [ $mode = block ]
+    then
+      RESULT=$(./loadgen.exe --clients $n --rate $RATE --duration $DURATION 127.0.0.1:$PORT)
+      echo "$RESULT" > $BASE
+    else
+      RESULT=$(./loadgen.exe --clients $n --rate $RATE --duration $DURATION --baseline $BASE 127.0.0.1:$PORT)
+    fi
+    echo "{\"mode\":\"$mode\",\"connections\":$n,\"loadgen\":$RESULT}"
+
+    kill $SERVER
+    wait $SERVER 2> /dev/null
+  done
+done
+
+rm -f $BASE
@@ -0,0 +1,53 @@
+#!/bin/sh
+# TLS : coût en régime établi (débit, latences, en clair contre TLS à charge
+# identique), débit de poignées de main complètes et reprises (tickets), et
+# latence de diffusion en clair pendant une vague de poignées de main.
+#
+# Usage : ./bench-tls.sh [connexions]
+# Prérequis : make TLS=1 server loadgen ; openssl (certificat de test et
+# "openssl s_time").
+
+CLIENTS=${1:-200}
+RATE=${RATE:-5}
+DURATION=${DURATION:-10}
+THREADS=${THREADS:-1}
+PORT=3101
+TLS_PORT=3443
+WORK=$(mktemp -d)
+
+ulimit -n 65536
+trap 'rm -rf $WORK' EXIT
+
+# Certificat auto-signé de test.
+openssl req -x509 -newkey rsa:2048 -nodes -subj /CN=localhost -days 1 \
+  -keyout $WORK/key.pem -out $WORK/cert.pem 2> /dev/null || exit 1
+
+./server.exe $PORT --tls $TLS_PORT --tls-cert $WORK/cert.pem --tls-key $WORK/key.pem --tls-threads $THREADS > /dev/null &
+SERVER=$!
+sleep 1
+
+# Régime établi.
+for transport in tcp tls
+do
+  ENDPOINT=127.0.0.1:$PORT
+  [ $transport = tls ] && ENDPOINT=tls:127.0.0.1:$TLS_PORT
+  RESULT=$(./loadgen.exe --clients $CLIENTS --rate $RATE --duration $DURATION $ENDPOINT)
+  echo "{\"transport\":\"$transport\",\"connections\":$CLIENTS,\"loadgen\":$RESULT}"
+done
+
+# Poignées de main par seconde : complètes, puis reprises.
+for mode in new reuse
+do
+  COUNT=$(openssl s_time -connect 127.0.0.1:$TLS_PORT -$mode -time $DURATION 2> /dev/null | grep "real seconds" | cut -d' ' -f1)
+  echo "{\"handshakes\":\"$mode\",\"per_s\":$(awk "BEGIN { print ${COUNT:-0} / $DURATION }")}"
+done
+
+# Diffusion en clair pendant une vague de poignées de main complètes.
+openssl s_time -connect 127.0.0.1:$TLS_PORT -new -time $((DURATION + 2)) > /dev/null 2>&1 &
+STORM=$!
+RESULT=$(./loadgen.exe --clients $CLIENTS --rate $RATE --duration $DURATION 127.0.0.1:$PORT)
+echo "{\"transport\":\"tcp\",\"handshake_storm\":true,\"connections\":$CLIENTS,\"loadgen\":$RESULT}"
+wait $STORM
+
+kill $SERVER
+wait $SERVER 2> /dev/null
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Comparaison TCP (boucle locale) / socket Unix : débit délivré et latences
+# p50, p99, p99.9 à charge identique, sur un même serveur.
+#
+# Usage : ./bench-uds.sh [connexions...]
+# Prérequis : make server loadgen.
+
+CONNECTIONS=${*:-"100 1000"}
+RATE=${RATE:-10}
+DURATION=${DURATION:-10}
+PORT=3101
+SOCKET=${SOCKET:-/tmp/chat-bench.sock}
+
+ulimit -n 65536
+
+./server.exe $PORT --unix $SOCKET > /dev/null &
+SERVER=$!
+sleep 1
+
+for n in $CONNECTIONS
+do
+  for transport in tcp unix
+  do
+    ENDPOINT=127.0.0.1:$PORT
+    [ $transport = unix ] && ENDPOINT=unix:$SOCKET
+    RESULT=$(./loadgen.exe --clients $n --rate $RATE --duration $DURATION $ENDPOINT)
+    echo "{\"transport\":\"$transport\",\"connections\":$n,\"loadgen\":$RESULT}"
+  done
+done
+
+kill $SERVER
+wait $SERVER 2> /dev/null
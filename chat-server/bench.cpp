@@ -0,0 +1,401 @@
+#include <cerrno>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <poll.h>
+#include "server.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// Bench ///////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Bancs d'essai des fonctions critiques du serveur, sur des connexions en
+// mémoire (MemoryTransport) : aucun socket, aucun appel système.
+// Résultat : une ligne JSON par cas, comparable d'une exécution à l'autre.
+class Bench
+{
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    Server m_server;
+    std::ostream & m_output;
+    std::string m_filter;
+    double m_time;
+    // Récepteur des envois sur un vrai socket ("hôte:port", vide : thread
+    // local par la boucle locale).
+    std::string m_target;
+    // Résultats consommés : les appels mesurés ne sont pas éliminés.
+    volatile std::size_t m_sink;
+
+  public:
+    Bench (std::ostream & output, const std::string & filter, double time, const std::string & target);
+    void run ();
+
+  private:
+    static Server::Options options ();
+    // Roster de n clients (sessions démarrées, alias "user<i>").
+    void populate (std::size_t n);
+    // Exécution des boucles d'écriture en attente.
+    void drain ();
+    // Mesure d'un cas : répétitions jusqu'à la durée minimale.
+    void measure (const std::string & name, std::size_t clients, const std::function<void ()> &);
+    // Cas de la famille "prefix" retenus par le filtre (préparation coûteuse).
+    bool selected (const std::string & prefix) const;
+    // Historique : indexation et requêtes sur un million de messages.
+    void search ();
+    // Envois sur un socket TCP, copie ordinaire contre MSG_ZEROCOPY.
+    void zerocopy ();
+};
+
+Bench::Bench (std::ostream & output, const std::string & filter, double time, const std::string & target) :
+  m_server {0, options ()},
+  m_output (output),
+  m_filter {filter},
+  m_time {time},
+  m_target {target},
+  m_sink {0}
+{
+}
+
+Server::Options Bench::options ()
+{
+  // Tampons de lecture réduits : 50 000 clients en mémoire.
+  Server::Options options;
+  options.read_buffers = 65536;
+  options.read_buffer_size = 256;
+  return options;
+}
+
+void Bench::populate (std::size_t n)
+{
+  while (m_server.m_clients.size () < n)
+  {
+    auto transport = std::make_unique<MemoryTransport> (m_server.m_context.get_executor ());
+    auto client = std::make_shared<Server::Client> (&m_server, std::move (transport));
+    client->rename ("user" + std::to_string (m_server.m_clients.size ()));
+    // Liste des numéros reçue : messages publics sous leur forme courte.
+    client->enlist ();
+    m_server.m_clients.push_back (client);
+    client->start ();
+  }
+  drain ();
+}
+
+void Bench::drain ()
+{
+  if (m_server.m_context.stopped ())
+    m_server.m_context.restart ();
+  m_server.m_context.poll ();
+}
+
+void Bench::measure (const std::string & name, std::size_t clients, const std::function<void ()> & f)
+{
+  if (name.find (m_filter) == std::string::npos) return;
+
+  // Répétitions par lots, doublés jusqu'à atteindre la durée minimale.
+  std::uint64_t iterations = 0;
+  std::uint64_t batch = 1;
+  Clock::duration elapsed {0};
+  while (std::chrono::duration<double> (elapsed).count () < m_time)
+  {
+    Clock::time_point begin = Clock::now ();
+    for (std::uint64_t i = 0; i < batch; ++i)
+      f ();
+    elapsed += Clock::now () - begin;
+    iterations += batch;
+    batch *= 2;
+  }
+
+  double ns = std::chrono::duration<double, std::nano> (elapsed).count () / iterations;
+  m_output << "{\"name\":\"" << name << "\""
+           << ",\"clients\":" << clients
+           << ",\"iterations\":" << iterations
+           << ",\"ns_per_op\":" << ns
+           << "}" << std::endl;
+}
+
+bool Bench::selected (const std::string & prefix) const
+{
+  return prefix.find (m_filter) != std::string::npos || m_filter.compare (0, prefix.size (), prefix) == 0;
+}
+
+void Bench::search ()
+{
+  const std::size_t DOCUMENTS = 1000000;
+  const std::size_t VOCABULARY = 50000;
+
+  // Messages de 8 mots, fréquences très inégales (quelques mots courants,
+  // beaucoup de mots rares).
+  std::mt19937 random {42};
+  std::uniform_real_distribution<double> uniform (0.0, 1.0);
+  std::vector<std::string> messages (4096);
+  for (std::string & message : messages)
+    for (int i = 0; i < 8; ++i)
+      message += "w" + std::to_string (static_cast<std::size_t> (std::pow (uniform (random), 4.0) * VOCABULARY)) + " ";
+
+  Index index {DOCUMENTS};
+  std::size_t count = 0;
+  measure ("search/index", 0, [&] {
+    index.add (0, "user0", messages [count++ & 4095]);
+  });
+  while (index.size () < DOCUMENTS)
+    index.add (0, "user0", messages [count++ & 4095]);
+
+  // Mot courant, mot rare, conjonction de deux mots courants.
+  const std::pair<const char *, const char *> queries [] = {{"common", "w0"}, {"rare", "w40000"}, {"and", "w0 w1"}};
+  for (const auto & query : queries)
+    measure (std::string ("search/query/") + query.first + "/" + std::to_string (DOCUMENTS), 0, [&] {
+      m_sink = m_sink + index.query (query.second, 20).size ();
+    });
+}
+
+// Envois de "size" octets sur un socket TCP, copie ordinaire ou MSG_ZEROCOPY
+// (notifications lues au fil de l'eau) : temps CPU du thread émetteur par
+// envoi. Vers "--sink <hôte:port>" (un récepteur qui jette tout, sur une autre
+// machine : vrai chemin de la carte réseau) ou vers un thread local par la
+// boucle locale, où le noyau copie quand même ("copied" : part des envois
+// copiés). Dernière ligne : plus petite taille à partir de laquelle l'envoi
+// sans copie coûte moins ("bytes", 0 si jamais).
+void Bench::zerocopy ()
+{
+  asio::io_context context;
+  asio::ip::tcp::socket socket {context};
+  asio::ip::tcp::acceptor acceptor {context};
+  std::thread receiver;
+
+  if (m_target.empty ())
+  {
+    acceptor.open (asio::ip::tcp::v4 ());
+    acceptor.bind ({asio::ip::address_v4::loopback (), 0});
+    acceptor.listen ();
+    receiver = std::thread {[&acceptor]
+    {
+      asio::ip::tcp::socket peer = acceptor.accept ();
+      std::vector<char> buffer (1 << 20);
+      asio::error_code ec;
+      while (! ec)
+        peer.read_some (asio::buffer (buffer), ec);
+    }};
+    socket.connect (acceptor.local_endpoint ());
+  }
+  else
+  {
+    std::string::size_type colon = m_target.rfind (':');
+    asio::ip::tcp::resolver resolver {context};
+    asio::connect (socket, resolver.resolve (m_target.substr (0, colon), m_target.substr (colon + 1)));
+  }
+
+  int fd = socket.native_handle ();
+  ZeroCopy zero {fd};
+  if (! zero.enabled ())
+    throw std::runtime_error ("SO_ZEROCOPY refusé par le noyau");
+
+  // Texte jamais modifié : il peut rester aux mains du noyau.
+  const std::vector<std::size_t> SIZES {1 << 10, 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20};
+  const std::string data (SIZES.back (), 'x');
+  auto owner = std::make_shared<int> (0);
+
+  auto send = [&] (std::size_t size, bool zerocopy)
+  {
+    std::size_t offset = 0;
+    while (offset < size)
+    {
+      asio::const_buffer buffer = asio::buffer (data.data () + offset, size - offset);
+      std::ptrdiff_t n = zerocopy ? zero.send (&buffer, 1, owner)
+                                  : ::send (fd, buffer.data (), buffer.size (), MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (n >= 0)
+      {
+        offset += static_cast<std::size_t> (n);
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+        throw std::runtime_error (std::string ("envoi : ") + std::strerror (errno));
+
+      // Socket plein (attente d'écriture) ou trop de notifications en
+      // attente (attente de la file d'erreurs).
+      pollfd ready {fd, static_cast<short> (errno == ENOBUFS ? 0 : POLLOUT), 0};
+      zero.reap ();
+      ::poll (&ready, 1, 100);
+    }
+    if (zerocopy)
+      zero.reap ();
+  };
+
+  std::size_t crossover = 0;
+  for (std::size_t size : SIZES)
+  {
+    double costs [2] = {0.0, 0.0};
+    for (bool zerocopy : {false, true})
+    {
+      std::string name = std::string ("zerocopy/") + (zerocopy ? "zero/" : "copy/") + std::to_string (size);
+      std::uint64_t completions = ZeroCopy::s_completions, copied = ZeroCopy::s_copied;
+
+      std::uint64_t sends = 0;
+      timespec begin, end;
+      ::clock_gettime (CLOCK_THREAD_CPUTIME_ID, &begin);
+      Clock::time_point deadline = Clock::now () + std::chrono::duration_cast<Clock::duration> (std::chrono::duration<double> (m_time));
+      while (Clock::now () < deadline)
+      {
+        send (size, zerocopy);
+        ++sends;
+      }
+      // Notifications restantes comptées avec le cas.
+      for (int i = 0; i < 100 && zero.pending () != 0; ++i)
+      {
+        pollfd ready {fd, 0, 0};
+        ::poll (&ready, 1, 10);
+        zero.reap ();
+      }
+      ::clock_gettime (CLOCK_THREAD_CPUTIME_ID, &end);
+
+      double ns = ((end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec)) / std::max<std::uint64_t> (sends, 1);
+      costs [zerocopy] = ns;
+      std::uint64_t notified = ZeroCopy::s_completions - completions;
+      m_output << "{\"name\":\"" << name << "\""
+               << ",\"clients\":1"
+               << ",\"bytes\":" << size
+               << ",\"iterations\":" << sends
+               << ",\"ns_per_op\":" << ns;
+      if (zerocopy)
+        m_output << ",\"copied\":" << (notified == 0 ? 0.0 : static_cast<double> (ZeroCopy::s_copied - copied) / notified);
+      m_output << "}" << std::endl;
+    }
+    if (crossover == 0 && costs [1] < costs [0])
+      crossover = size;
+  }
+  m_output << "{\"name\":\"zerocopy/crossover\",\"bytes\":" << crossover << "}" << std::endl;
+
+  asio::error_code ec;
+  socket.close (ec);
+  if (receiver.joinable ())
+    receiver.join ();
+}
+
+void Bench::run ()
+{
+  if (selected ("search/"))
+    search ();
+
+#if defined(CHAT_HAS_ZEROCOPY)
+  if (selected ("zerocopy/"))
+    zerocopy ();
+#endif
+
+  populate (10);
+  Server::ClientPtr client = m_server.m_clients.front ();
+
+  // Analyse d'une commande (commande inconnue : lecture, recherche, erreur).
+  std::size_t count = 0;
+  measure ("process/parse", 10, [&] {
+    m_server.process (client, "/nosuch un deux trois");
+    if (++count % 1024 == 0) drain ();
+  });
+  drain ();
+
+  // Journal : mise en forme et dépôt dans l'anneau du thread (répétitions
+  // résumées par le thread de fond).
+  measure ("log/info", 0, [&] {
+    Log::info ("Bench", "alias", client->alias (), "n", count++);
+  });
+
+  // Aiguillage : recherche du processeur.
+  const std::string commands [] = {"/quit", "/list", "/alias", "/private"};
+  measure ("process/dispatch", 10, [&] {
+    m_sink = m_sink + (Server::PROCESSORS.find (commands [count++ & 3]) != Server::PROCESSORS.end ());
+  });
+
+  // Admission : connexion puis fermeture, 100 000 adresses distinctes
+  // (table pleine de seaux en cours de décharge).
+  Admission admission {16, 10.0, 20.0};
+  measure ("admission/admit/100000", 0, [&] {
+    Admission::Key key = 0x0a000000 + (count++ % 100000);
+    std::chrono::nanoseconds now = Clock::now ().time_since_epoch ();
+    if (admission.admit (key, now) == Admission::ADMITTED)
+      admission.release (key);
+  });
+
+  // Message public complet (analyse, mise en forme, diffusion).
+  measure ("process/message", 10, [&] {
+    m_server.process (client, "bonjour tout le monde");
+    drain ();
+  });
+
+  for (std::size_t n : {10, 100, 1000, 10000, 50000})
+  {
+    populate (n);
+    std::string last = "user" + std::to_string (n - 1);
+
+    // Recherche par alias : pire cas (dernier client) et alias absent.
+    measure ("find/hit/" + std::to_string (n), n, [&] { m_sink = m_sink + (m_server.find (last) != nullptr); });
+    measure ("find/miss/" + std::to_string (n), n, [&] { m_sink = m_sink + (m_server.find ("nobody") != nullptr); });
+
+    if (n == 10 || n == 1000 || n == 50000)
+    {
+      // Diffusion : mise en file pour chaque client et écriture.
+      measure ("broadcast/" + std::to_string (n), n, [&] {
+        m_server.broadcast ("<b>user0</b> : bonjour tout le monde", Server::MESSAGES);
+        drain ();
+      });
+
+      // Sérialisation de la liste des utilisateurs.
+      measure ("list/" + std::to_string (n), n, [&] {
+        m_server.process_list (client, std::string ());
+        drain ();
+      });
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main ////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+int usage ()
+{
+  std::cerr << "Usage: bench [--filter <nom>] [--time <s>] [--sink <hôte:port>]" << std::endl;
+  return 1;
+}
+
+int main (int argc, char * argv [])
+{
+  std::string filter;
+  double time = 0.2;
+  std::string target;
+
+  try
+  {
+    for (int i = 1; i < argc; i += 2)
+    {
+      std::string option {argv [i]};
+      if (i + 1 == argc)
+        return usage ();
+      else if (option == "--filter")
+        filter = argv [i + 1];
+      else if (option == "--time")
+        time = std::stod (argv [i + 1]);
+      else if (option == "--sink")
+        target = argv [i + 1];
+      else
+        return usage ();
+    }
+  }
+  catch (std::exception &)
+  {
+    return usage ();
+  }
+
+  // Les traces du serveur (std::cout) sont écartées : seuls les résultats
+  // sont écrits sur la sortie standard.
+  std::ostream output {std::cout.rdbuf ()};
+  std::cout.rdbuf (nullptr);
+
+  Bench bench {output, filter, time, target};
+  bench.run ();
+
+  return 0;
+}
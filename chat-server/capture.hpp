@@ -0,0 +1,212 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <asio.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+// Capture /////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Enregistrement du trafic entrant (rejoué par replay.cpp). Fichier binaire :
+// "CHATCAP1", puis une suite d'enregistrements
+//   <délai µs> <connexion> <type> [<longueur> <octets>]
+// (entiers en varint LEB128, délai depuis l'enregistrement précédent). Types :
+// ouverture, ligne reçue, fermeture, jeton de session attribué (pour rejouer
+// "/resume" avec les jetons du nouveau serveur). Écriture par blocs de 64 Kio
+// sur un fil dédié : le fil du serveur ne fait que remplir le bloc courant.
+class Capture
+{
+  public:
+    enum Kind : std::uint8_t { OPEN, LINE, CLOSE, SESSION };
+
+    struct Record
+    {
+      // Date depuis le début de la capture (microsecondes).
+      std::uint64_t time;
+      std::uint32_t connection;
+      Kind kind;
+      std::string text;
+    };
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    // Fichier (fil d'écriture seulement), bloc en cours de remplissage.
+    std::ofstream m_file;
+    bool m_enabled;
+    std::string m_buffer;
+    Clock::time_point m_last;
+    asio::io_context m_context;
+    asio::executor_work_guard<asio::io_context::executor_type> m_guard;
+    std::thread m_thread;
+
+    static void put (std::string &, std::uint64_t);
+    static bool get (const char * & data, const char * end, std::uint64_t &);
+
+  public:
+    // Chemin vide : capture désactivée.
+    explicit Capture (const std::string & path);
+    ~Capture ();
+    bool enabled () const;
+    // Fil d'écriture (non démarré si la capture est désactivée).
+    std::thread & thread ();
+    void record (std::uint32_t connection, Kind, std::string_view text = {});
+    // Bloc courant confié au fil d'écriture ; "sync" attend qu'il soit
+    // écrit, comme les précédents (arrêt du processus).
+    void flush ();
+    void sync ();
+    // Lecture d'un fichier complet (std::runtime_error s'il est invalide ;
+    // un dernier enregistrement tronqué est ignoré).
+    static std::vector<Record> load (const std::string & path);
+
+  private:
+    static constexpr std::string_view MAGIC = "CHATCAP1";
+    static constexpr std::size_t BLOCK = 64 << 10;
+};
+
+inline Capture::Capture (const std::string & path) :
+  m_file {},
+  m_enabled {false},
+  m_buffer {},
+  m_last {Clock::now ()},
+  m_context {1},
+  m_guard {asio::make_work_guard (m_context)},
+  m_thread {}
+{
+  if (path.empty ()) return;
+
+  m_file.open (path, std::ios::binary | std::ios::trunc);
+  if (! m_file)
+    throw std::runtime_error ("capture impossible : " + path);
+  m_enabled = true;
+  m_buffer.reserve (2 * BLOCK);
+  m_buffer.append (MAGIC);
+  m_thread = std::thread {[this] { m_context.run (); }};
+}
+
+inline Capture::~Capture ()
+{
+  // Dernier bloc et blocs en attente écrits avant l'arrêt.
+  flush ();
+  m_guard.reset ();
+  if (m_thread.joinable ())
+    m_thread.join ();
+}
+
+inline bool Capture::enabled () const
+{
+  return m_enabled;
+}
+
+inline std::thread & Capture::thread ()
+{
+  return m_thread;
+}
+
+inline void Capture::put (std::string & out, std::uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    out += static_cast<char> (value | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char> (value);
+}
+
+inline bool Capture::get (const char * & data, const char * end, std::uint64_t & value)
+{
+  value = 0;
+  for (int shift = 0; data != end && shift < 64; shift += 7)
+  {
+    std::uint8_t byte = static_cast<std::uint8_t> (*data++);
+    value |= static_cast<std::uint64_t> (byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+inline void Capture::record (std::uint32_t connection, Kind kind, std::string_view text)
+{
+  if (! enabled ()) return;
+
+  Clock::time_point now = Clock::now ();
+  put (m_buffer, std::chrono::duration_cast<std::chrono::microseconds> (now - m_last).count ());
+  // Délai arrondi : la date suivante part de la date enregistrée.
+  m_last += std::chrono::duration_cast<std::chrono::microseconds> (now - m_last);
+  put (m_buffer, connection);
+  m_buffer += static_cast<char> (kind);
+  if (kind == LINE || kind == SESSION)
+  {
+    put (m_buffer, text.size ());
+    m_buffer.append (text);
+  }
+
+  if (m_buffer.size () >= BLOCK)
+    flush ();
+}
+
+inline void Capture::flush ()
+{
+  if (! enabled () || m_buffer.empty ()) return;
+
+  std::string block;
+  block.reserve (2 * BLOCK);
+  block.swap (m_buffer);
+  asio::post (m_context, [this, block = std::move (block)]
+  {
+    m_file.write (block.data (), static_cast<std::streamsize> (block.size ()));
+    m_file.flush ();
+  });
+}
+
+inline void Capture::sync ()
+{
+  if (! enabled ()) return;
+
+  flush ();
+  std::promise<void> written;
+  asio::post (m_context, [&written] { written.set_value (); });
+  written.get_future ().wait ();
+}
+
+inline std::vector<Capture::Record> Capture::load (const std::string & path)
+{
+  std::ifstream file {path, std::ios::binary};
+  if (! file)
+    throw std::runtime_error ("capture illisible : " + path);
+  std::string content {std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+  if (content.compare (0, MAGIC.size (), MAGIC) != 0)
+    throw std::runtime_error ("pas une capture : " + path);
+
+  std::vector<Record> records;
+  const char * data = content.data () + MAGIC.size ();
+  const char * end = content.data () + content.size ();
+  std::uint64_t time = 0;
+  while (data != end)
+  {
+    std::uint64_t delay, connection, size = 0;
+    if (! get (data, end, delay) || ! get (data, end, connection) || data == end) break;
+    Kind kind = static_cast<Kind> (*data++);
+    if (kind > SESSION)
+      throw std::runtime_error ("capture corrompue : " + path);
+    if ((kind == LINE || kind == SESSION) && (! get (data, end, size) || size > static_cast<std::uint64_t> (end - data))) break;
+
+    time += delay;
+    records.push_back (Record {time, static_cast<std::uint32_t> (connection), kind, std::string (data, size)});
+    data += size;
+  }
+  return records;
+}
+
+#endif // CAPTURE_HPP
@@ -0,0 +1,60 @@
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include <chrono>
+#include <asio.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+// VirtualClock ////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Horloge virtuelle des minuteries du serveur en simulation (CHAT_VIRTUAL_CLOCK) :
+// l'heure n'avance que sur demande, la fenêtre de présence ou le délai de
+// grâce s'écoulent sans attente réelle, et deux exécutions de même graine
+// voient exactement les mêmes échéances. Un seul thread.
+class VirtualClock
+{
+  public:
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<VirtualClock> time_point;
+    static constexpr bool is_steady = true;
+
+  private:
+    static inline time_point s_now {};
+
+  public:
+    static time_point now ();
+    static void advance (duration);
+};
+
+// Attente réelle toujours nulle : le réacteur ne dort pas, les échéances sont
+// comparées à l'heure virtuelle à chaque "poll".
+struct VirtualWaitTraits
+{
+  static VirtualClock::duration to_wait_duration (const VirtualClock::duration &);
+  static VirtualClock::duration to_wait_duration (const VirtualClock::time_point &);
+};
+
+inline VirtualClock::time_point VirtualClock::now ()
+{
+  return s_now;
+}
+
+inline void VirtualClock::advance (duration d)
+{
+  s_now += d;
+}
+
+inline VirtualClock::duration VirtualWaitTraits::to_wait_duration (const VirtualClock::duration &)
+{
+  return VirtualClock::duration::zero ();
+}
+
+inline VirtualClock::duration VirtualWaitTraits::to_wait_duration (const VirtualClock::time_point &)
+{
+  return VirtualClock::duration::zero ();
+}
+
+#endif // CLOCK_HPP
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Cluster local : N nœuds en maillage complet, puis générateur de charge
+# réparti sur tous les nœuds.
+#
+# Usage : ./cluster.sh [nœuds] [options du générateur...]
+# Exemple : ./cluster.sh 3 --clients 300 --rate 2 --duration 10 --private 0.2
+
+NODES=${1:-3}
+[ $# -gt 0 ] && shift
+
+PORT=3101
+CLUSTER=4101
+PIDS=""
+ENDPOINTS=""
+
+i=0
+while [ $i -lt $NODES ]
+do
+  # Chaque nœud contacte les nœuds démarrés avant lui.
+  PEERS=""
+  j=0
+  while [ $j -lt $i ]
+  do
+    PEERS="$PEERS --peer 127.0.0.1:$((CLUSTER + j))"
+    j=$((j + 1))
+  done
+
+  ./server.exe $((PORT + i)) --node n$i --cluster-port $((CLUSTER + i)) $PEERS &
+  PIDS="$PIDS $!"
+  ENDPOINTS="$ENDPOINTS 127.0.0.1:$((PORT + i))"
+  i=$((i + 1))
+done
+
+trap 'kill $PIDS 2>/dev/null' EXIT INT TERM
+
+# Laisser les liaisons s'établir.
+sleep 2
+
+./loadgen.exe "$@" $ENDPOINTS
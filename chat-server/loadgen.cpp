@@ -0,0 +1,421 @@
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <asio.hpp>
+#if defined(CHAT_TLS)
+#include <asio/ssl.hpp>
+#endif
+#include "metrics.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// Bot /////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Paramètres de la charge.
+struct Load
+{
+  std::size_t clients = 100;
+  double rate = 1.0;      // messages par seconde et par client (0 : passif)
+  double duration = 10.0; // secondes
+  std::size_t size = 32;  // octets de remplissage par message
+  double ratio = 0.0;     // part des messages privés
+  std::string prefix;
+  std::string events;     // abonnements ("/session <alias> <événements>")
+  std::vector<std::string> endpoints;
+#if defined(CHAT_TLS)
+  // Contexte client (certificat du serveur non vérifié : mesure seulement).
+  asio::ssl::context * ssl = nullptr;
+#endif
+};
+
+// Compteurs globaux (contexte mono-thread).
+struct Stats
+{
+  Histogram latency;
+  std::uint64_t sent = 0;
+  std::uint64_t received = 0;
+  std::uint64_t errors = 0;
+  std::uint64_t bytes = 0;
+  std::size_t logged = 0;
+};
+
+typedef std::chrono::steady_clock Clock;
+// Serveur TCP ou socket Unix, en clair ou TLS.
+typedef asio::generic::stream_protocol::endpoint Endpoint;
+struct Target
+{
+  std::vector<Endpoint> endpoints;
+  bool tls = false;
+};
+
+// Client simulé : connexion, alias, puis envoi périodique de messages
+// horodatés ; les latences sont mesurées à la réception.
+class Bot : public std::enable_shared_from_this<Bot>
+{
+  private:
+    asio::io_context & m_context;
+    asio::generic::stream_protocol::socket m_socket;
+#if defined(CHAT_TLS)
+    // Flux TLS sur m_socket (nul : en clair).
+    std::unique_ptr<asio::ssl::stream<asio::generic::stream_protocol::socket &>> m_tls;
+#endif
+    asio::steady_timer m_timer;
+    asio::streambuf m_buffer;
+    std::deque<std::string> m_queue;
+    const Load & m_load;
+    Stats & m_stats;
+    std::size_t m_index;
+    std::string m_alias;
+    std::mt19937 m_random;
+    Clock::time_point m_deadline;
+
+  public:
+    Bot (asio::io_context &, const Load &, Stats &, std::size_t index);
+    void start (const Target &);
+    void stop ();
+
+  private:
+    void login ();
+    void read ();
+    void process (const std::string &);
+    void tick ();
+    void write (const std::string &);
+    void flush ();
+};
+
+Bot::Bot (asio::io_context & context, const Load & load, Stats & stats, std::size_t index) :
+  m_context (context),
+  m_socket {context},
+  m_timer {context},
+  m_load (load),
+  m_stats (stats),
+  m_index {index},
+  m_alias {load.prefix + std::to_string (index)},
+  m_random {static_cast<std::mt19937::result_type> (index)}
+{
+}
+
+void Bot::start (const Target & target)
+{
+#if defined(CHAT_TLS)
+  if (target.tls)
+    m_tls = std::make_unique<asio::ssl::stream<asio::generic::stream_protocol::socket &>> (m_socket, *m_load.ssl);
+#endif
+
+  auto self = shared_from_this ();
+  asio::async_connect (m_socket, target.endpoints,
+    [this, self] (const std::error_code & ec, const Endpoint &)
+    {
+      if (ec)
+      {
+        ++m_stats.errors;
+        return;
+      }
+      // TCP uniquement (sans effet sur un socket Unix).
+      asio::error_code ignored;
+      m_socket.set_option (asio::ip::tcp::no_delay (true), ignored);
+
+#if defined(CHAT_TLS)
+      if (m_tls)
+      {
+        m_tls->async_handshake (asio::ssl::stream_base::client,
+          [this, self] (const std::error_code & ec)
+          {
+            if (ec)
+              ++m_stats.errors;
+            else
+              login ();
+          });
+        return;
+      }
+#endif
+      login ();
+    });
+}
+
+void Bot::login ()
+{
+  write (m_load.events.empty () ? m_alias : "/session " + m_alias + " " + m_load.events);
+  read ();
+}
+
+void Bot::stop ()
+{
+  m_timer.cancel ();
+  asio::error_code ec;
+  m_socket.close (ec);
+}
+
+void Bot::read ()
+{
+  auto self = shared_from_this ();
+  auto handler =
+    [this, self] (const std::error_code & ec, std::size_t)
+    {
+      if (ec) return;
+      // Lignes complètes uniquement : la fin du tampon peut être partielle.
+      std::string data {asio::buffers_begin (m_buffer.data ()), asio::buffers_end (m_buffer.data ())};
+      std::string::size_type begin = 0, eol;
+      while ((eol = data.find ('\n', begin)) != std::string::npos)
+      {
+        process (data.substr (begin, eol - begin));
+        begin = eol + 1;
+      }
+      m_buffer.consume (begin);
+      read ();
+    };
+
+#if defined(CHAT_TLS)
+  if (m_tls)
+  {
+    asio::async_read_until (*m_tls, m_buffer, '\n', handler);
+    return;
+  }
+#endif
+  asio::async_read_until (m_socket, m_buffer, '\n', handler);
+}
+
+void Bot::process (const std::string & line)
+{
+  m_stats.bytes += line.size () + 1;
+
+  // Premier "#alias" : début de l'envoi (aucun envoi à débit nul).
+  if (line.compare (0, 7, "#alias ") == 0)
+  {
+    if (++m_stats.logged == m_load.clients)
+      std::cerr << "loadgen: " << m_load.clients << " clients connectés" << std::endl;
+    if (m_load.rate == 0.0) return;
+    m_deadline = Clock::now () + std::chrono::duration_cast<Clock::duration> (std::chrono::duration<double> (m_load.duration));
+    // Départ décalé pour lisser la charge.
+    std::uniform_real_distribution<double> jitter (0.0, 1.0 / m_load.rate);
+    m_timer.expires_after (std::chrono::duration_cast<Clock::duration> (std::chrono::duration<double> (jitter (m_random))));
+    auto self = shared_from_this ();
+    m_timer.async_wait ([this, self] (const std::error_code & ec) { if (! ec) tick (); });
+    return;
+  }
+
+  if (line.compare (0, 7, "#error ") == 0)
+  {
+    ++m_stats.errors;
+    return;
+  }
+
+  // Message horodaté : "... ts=<ns> ...".
+  std::string::size_type ts = line.find (" ts=");
+  if (ts != std::string::npos)
+  {
+    std::int64_t sent = std::stoll (line.substr (ts + 4));
+    std::int64_t now = Clock::now ().time_since_epoch ().count ();
+    std::int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds> (Clock::duration (now - sent)).count ();
+    m_stats.latency.add (static_cast<std::uint64_t> (std::max<std::int64_t> (ns, 0) / 1000));
+    ++m_stats.received;
+  }
+}
+
+void Bot::tick ()
+{
+  if (Clock::now () >= m_deadline) return;
+
+  std::string payload = " ts=" + std::to_string (Clock::now ().time_since_epoch ().count ()) + " " + std::string (m_load.size, 'x');
+
+  std::uniform_real_distribution<double> coin (0.0, 1.0);
+  if (m_load.ratio > 0.0 && coin (m_random) < m_load.ratio)
+  {
+    std::uniform_int_distribution<std::size_t> pick (0, m_load.clients - 1);
+    write ("/private " + m_load.prefix + std::to_string (pick (m_random)) + payload);
+  }
+  else
+    write ("msg" + payload);
+  ++m_stats.sent;
+
+  m_timer.expires_at (m_timer.expiry () + std::chrono::duration_cast<Clock::duration> (std::chrono::duration<double> (1.0 / m_load.rate)));
+  auto self = shared_from_this ();
+  m_timer.async_wait ([this, self] (const std::error_code & ec) { if (! ec) tick (); });
+}
+
+void Bot::write (const std::string & line)
+{
+  bool idle = m_queue.empty ();
+  m_queue.push_back (line + '\n');
+  if (idle) flush ();
+}
+
+void Bot::flush ()
+{
+  auto self = shared_from_this ();
+  auto handler =
+    [this, self] (const std::error_code & ec, std::size_t)
+    {
+      if (ec)
+      {
+        m_queue.clear ();
+        return;
+      }
+      m_queue.pop_front ();
+      if (! m_queue.empty ()) flush ();
+    };
+
+#if defined(CHAT_TLS)
+  if (m_tls)
+  {
+    asio::async_write (*m_tls, asio::buffer (m_queue.front ()), handler);
+    return;
+  }
+#endif
+  asio::async_write (m_socket, asio::buffer (m_queue.front ()), handler);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main ////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Champ numérique d'un résultat précédent (ligne JSON de loadgen), NaN
+// s'il manque.
+double field (const std::string & json, const std::string & key)
+{
+  std::string::size_type at = json.find ("\"" + key + "\":");
+  if (at == std::string::npos) return std::nan ("");
+  return std::strtod (json.c_str () + at + key.size () + 3, nullptr);
+}
+
+int usage ()
+{
+  std::cerr << "Usage: loadgen [--clients <n>] [--rate <msg/s>] [--duration <s>] [--size <octets>]"
+               " [--private <ratio>] [--prefix <alias>] [--events <événements>] [--baseline <résultat.json>]"
+               " <hôte:port | unix:chemin | tls:hôte:port>..." << std::endl;
+  return 1;
+}
+
+int main (int argc, char * argv [])
+{
+  Load load;
+  load.prefix = "bot" + std::to_string (::getpid ()) + "_";
+  // Résultat de référence (même charge, autre configuration du serveur).
+  std::string baseline;
+
+  try
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string option {argv [i]};
+      if (option.compare (0, 2, "--") != 0)
+        load.endpoints.push_back (option);
+      else if (i + 1 == argc)
+        return usage ();
+      else if (option == "--clients")
+        load.clients = std::stoul (argv [++i]);
+      else if (option == "--rate")
+        load.rate = std::stod (argv [++i]);
+      else if (option == "--duration")
+        load.duration = std::stod (argv [++i]);
+      else if (option == "--size")
+        load.size = std::stoul (argv [++i]);
+      else if (option == "--private")
+        load.ratio = std::stod (argv [++i]);
+      else if (option == "--prefix")
+        load.prefix = argv [++i];
+      else if (option == "--events")
+        load.events = argv [++i];
+      else if (option == "--baseline")
+      {
+        std::ifstream file {argv [++i]};
+        if (! std::getline (file, baseline))
+          return usage ();
+      }
+      else
+        return usage ();
+    }
+  }
+  catch (std::exception &)
+  {
+    return usage ();
+  }
+
+  if (load.endpoints.empty () || load.clients == 0 || load.rate < 0.0)
+    return usage ();
+
+  asio::io_context context;
+  asio::ip::tcp::resolver resolver {context};
+
+#if defined(CHAT_TLS)
+  asio::ssl::context ssl {asio::ssl::context::tls_client};
+  ssl.set_verify_mode (asio::ssl::verify_none);
+  load.ssl = &ssl;
+#endif
+
+  // Résolution des serveurs ; les clients sont répartis à tour de rôle.
+  std::vector<Target> servers;
+  for (std::string endpoint : load.endpoints)
+  {
+    Target target;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    if (endpoint.compare (0, 5, "unix:") == 0)
+    {
+      target.endpoints.push_back (asio::local::stream_protocol::endpoint {endpoint.substr (5)});
+      servers.push_back (target);
+      continue;
+    }
+#endif
+#if defined(CHAT_TLS)
+    if (endpoint.compare (0, 4, "tls:") == 0)
+    {
+      target.tls = true;
+      endpoint.erase (0, 4);
+    }
+#endif
+    std::string::size_type colon = endpoint.rfind (':');
+    if (colon == std::string::npos) return usage ();
+    for (const auto & entry : resolver.resolve (endpoint.substr (0, colon), endpoint.substr (colon + 1)))
+      target.endpoints.emplace_back (entry.endpoint ());
+    servers.push_back (target);
+  }
+
+  Stats stats;
+  std::vector<std::shared_ptr<Bot>> bots;
+  for (std::size_t i = 0; i < load.clients; ++i)
+  {
+    bots.push_back (std::make_shared<Bot> (context, load, stats, i));
+    bots.back ()->start (servers [i % servers.size ()]);
+  }
+
+  // Fin : durée de la charge plus une seconde pour vider les files.
+  Clock::time_point begin = Clock::now ();
+  asio::steady_timer end {context};
+  end.expires_after (std::chrono::duration_cast<Clock::duration> (std::chrono::duration<double> (load.duration + 1.0)));
+  end.async_wait ([&bots] (const std::error_code &) {
+    for (auto & bot : bots) bot->stop ();
+  });
+
+  context.run ();
+
+  double elapsed = std::chrono::duration<double> (Clock::now () - begin).count ();
+
+  // Résultat : une ligne JSON.
+  std::cout << "{\"clients\":" << load.clients
+            << ",\"servers\":" << servers.size ()
+            << ",\"sent\":" << stats.sent
+            << ",\"received\":" << stats.received
+            << ",\"errors\":" << stats.errors
+            << ",\"bytes_received\":" << stats.bytes
+            << ",\"elapsed_s\":" << elapsed
+            << ",\"delivered_per_s\":" << (stats.received / load.duration)
+            << ",\"p50_us\":" << stats.latency.percentile (0.50)
+            << ",\"p99_us\":" << stats.latency.percentile (0.99)
+            << ",\"p999_us\":" << stats.latency.percentile (0.999);
+  // Écart avec la référence (négatif : plus rapide).
+  if (! baseline.empty ())
+    std::cout << ",\"baseline_p99_us\":" << field (baseline, "p99_us")
+              << ",\"baseline_p999_us\":" << field (baseline, "p999_us")
+              << ",\"p99_delta_us\":" << static_cast<double> (stats.latency.percentile (0.99)) - field (baseline, "p99_us")
+              << ",\"p999_delta_us\":" << static_cast<double> (stats.latency.percentile (0.999)) - field (baseline, "p999_us");
+  std::cout << "}" << std::endl;
+
+  return 0;
+}
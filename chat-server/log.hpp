@@ -0,0 +1,406 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Log /////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Journal asynchrone : un événement (chaîne littérale) et des champs
+// "clé=valeur", mis en forme dans un enregistrement de taille fixe et déposés
+// dans un anneau propre au thread (un seul producteur, sans verrou ni
+// allocation). Un thread de fond vide les anneaux vers un fichier ou la
+// sortie d'erreur ; au-delà de REPEAT_LIMIT occurrences d'un même événement
+// par seconde, les suivantes sont comptées et résumées en une ligne.
+// Anneau plein : enregistrement perdu (compté), le thread n'attend jamais.
+class Log
+{
+  public:
+    enum Level : std::uint8_t { DEBUG, INFO, WARNING, SEVERE };
+
+    // Enregistrements par thread (puissance de deux), texte des champs
+    // (tronqué au-delà), occurrences affichées par événement et par seconde.
+    static const std::size_t CAPACITY = 1 << 12;
+    static const std::size_t TEXT = 192;
+    static const std::uint32_t REPEAT_LIMIT = 10;
+
+  private:
+    struct Record
+    {
+      std::int64_t time; // millisecondes depuis 1970
+      const char * event;
+      Level level;
+      std::uint16_t size;
+      char text [TEXT];
+    };
+
+    // Anneau d'un thread : écrit par son seul thread, vidé par le thread de fond.
+    struct Ring
+    {
+      std::atomic<std::uint64_t> head {0};
+      std::atomic<std::uint64_t> tail {0};
+      std::atomic<std::uint64_t> dropped {0};
+      std::vector<Record> records = std::vector<Record> (CAPACITY);
+    };
+
+    // Occurrences d'un événement dans la seconde en cours.
+    struct Repeat
+    {
+      std::int64_t second = 0;
+      std::uint32_t count = 0;
+      std::uint64_t suppressed = 0;
+      Level level = INFO;
+    };
+
+    static inline std::atomic<std::uint8_t> s_level {INFO};
+    static inline std::mutex s_mutex;
+    static inline std::vector<std::shared_ptr<Ring>> s_rings;
+    // Thread de fond (démarré par le premier "start", arrêté par le dernier
+    // "stop") et destination.
+    static inline std::size_t s_users = 0;
+    static inline std::thread s_thread;
+    static inline std::condition_variable s_stop;
+    static inline bool s_running = false;
+    static inline std::FILE * s_output = nullptr;
+
+    static Ring & ring ();
+    static const char * name (Level);
+    static void append (Record &, std::string_view);
+    static void field (Record &, std::string_view key, std::string_view value);
+    template <typename T>
+    static void field (Record &, std::string_view key, const T & value);
+    static void fields (Record &);
+    template <typename Value, typename... Fields>
+    static void fields (Record &, std::string_view key, const Value & value, const Fields &... rest);
+    // Thread de fond : vidage périodique, résumés des répétitions.
+    static void drain ();
+    static void flush (std::unordered_map<const char *, Repeat> &, std::int64_t second, std::string & out);
+    static void line (std::string & out, std::int64_t time, Level, const char * event, std::string_view text);
+
+  public:
+    // Journal ouvert le temps de sa vie (membre d'un serveur).
+    class Sink
+    {
+      public:
+        Sink (const std::string & path, Level);
+        ~Sink ();
+        Sink (const Sink &) = delete;
+        Sink & operator= (const Sink &) = delete;
+    };
+
+    // Démarrage du thread de fond ; "path" vide : sortie d'erreur.
+    static void start (const std::string & path, Level);
+    static void stop ();
+    static Level level ();
+    static bool enabled (Level);
+    // Niveau d'après son nom ("debug", "info", "warning", "severe").
+    static Level parse (const std::string &);
+    // Thread de fond (placement sur des CPU choisis).
+    static std::thread & thread ();
+
+    // "event" : chaîne littérale (clé des répétitions) ; "fields" : paires
+    // clé, valeur (texte ou nombre).
+    template <typename... Fields>
+    static void write (Level, const char * event, const Fields &... fields);
+    template <typename... Fields>
+    static void debug (const char * event, const Fields &... fields);
+    template <typename... Fields>
+    static void info (const char * event, const Fields &... fields);
+    template <typename... Fields>
+    static void warning (const char * event, const Fields &... fields);
+    template <typename... Fields>
+    static void severe (const char * event, const Fields &... fields);
+};
+
+inline Log::Sink::Sink (const std::string & path, Level level)
+{
+  start (path, level);
+}
+
+inline Log::Sink::~Sink ()
+{
+  stop ();
+}
+
+inline Log::Ring & Log::ring ()
+{
+  // Premier enregistrement du thread : création et inscription de l'anneau.
+  thread_local std::shared_ptr<Ring> ring;
+  if (ring == nullptr)
+  {
+    ring = std::make_shared<Ring> ();
+    std::lock_guard<std::mutex> lock {s_mutex};
+    s_rings.push_back (ring);
+  }
+  return *ring;
+}
+
+inline const char * Log::name (Level level)
+{
+  switch (level)
+  {
+    case DEBUG:   return "DEBUG";
+    case INFO:    return "INFO";
+    case WARNING: return "WARNING";
+    case SEVERE:  return "SEVERE";
+  }
+  return "?";
+}
+
+inline void Log::append (Record & record, std::string_view text)
+{
+  std::size_t n = std::min (text.size (), TEXT - record.size);
+  std::memcpy (record.text + record.size, text.data (), n);
+  record.size += n;
+}
+
+inline void Log::field (Record & record, std::string_view key, std::string_view value)
+{
+  // Valeur entre guillemets si elle contient un espace.
+  bool quoted = value.empty () || value.find (' ') != std::string_view::npos;
+  append (record, " ");
+  append (record, key);
+  append (record, quoted ? "=\"" : "=");
+  append (record, value);
+  if (quoted) append (record, "\"");
+}
+
+template <typename T>
+void Log::field (Record & record, std::string_view key, const T & value)
+{
+  if constexpr (std::is_arithmetic_v<T>)
+  {
+    char digits [32];
+    auto result = std::to_chars (digits, digits + sizeof (digits), value);
+    field (record, key, std::string_view {digits, static_cast<std::size_t> (result.ptr - digits)});
+  }
+  else
+    field (record, key, std::string_view {value});
+}
+
+inline void Log::fields (Record &)
+{
+}
+
+template <typename Value, typename... Fields>
+void Log::fields (Record & record, std::string_view key, const Value & value, const Fields &... rest)
+{
+  field (record, key, value);
+  fields (record, rest...);
+}
+
+inline void Log::start (const std::string & path, Level level)
+{
+  std::lock_guard<std::mutex> lock {s_mutex};
+  s_level.store (level, std::memory_order_relaxed);
+  if (s_users++ != 0) return;
+
+  s_output = stderr;
+  if (! path.empty ())
+  {
+    s_output = std::fopen (path.c_str (), "a");
+    if (s_output == nullptr)
+    {
+      s_users = 0;
+      throw std::runtime_error {"Journal : ouverture impossible de " + path};
+    }
+  }
+  s_running = true;
+  s_thread = std::thread {&Log::drain};
+}
+
+inline std::thread & Log::thread ()
+{
+  return s_thread;
+}
+
+inline void Log::stop ()
+{
+  {
+    std::lock_guard<std::mutex> lock {s_mutex};
+    if (s_users == 0 || --s_users != 0) return;
+    s_running = false;
+  }
+  s_stop.notify_all ();
+  s_thread.join ();
+
+  if (s_output != stderr)
+    std::fclose (s_output);
+  s_output = nullptr;
+}
+
+inline Log::Level Log::level ()
+{
+  return static_cast<Level> (s_level.load (std::memory_order_relaxed));
+}
+
+inline bool Log::enabled (Level level)
+{
+  return level >= s_level.load (std::memory_order_relaxed);
+}
+
+inline Log::Level Log::parse (const std::string & name)
+{
+  if (name == "debug")   return DEBUG;
+  if (name == "info")    return INFO;
+  if (name == "warning") return WARNING;
+  if (name == "severe")  return SEVERE;
+  throw std::invalid_argument {"Niveau de journal inconnu : " + name};
+}
+
+template <typename... Fields>
+void Log::write (Level level, const char * event, const Fields &... values)
+{
+  if (! enabled (level)) return;
+
+  Ring & r = ring ();
+  std::uint64_t head = r.head.load (std::memory_order_relaxed);
+  if (head - r.tail.load (std::memory_order_acquire) == CAPACITY)
+  {
+    r.dropped.fetch_add (1, std::memory_order_relaxed);
+    return;
+  }
+
+  Record & record = r.records [head & (CAPACITY - 1)];
+  record.time = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::system_clock::now ().time_since_epoch ()).count ();
+  record.event = event;
+  record.level = level;
+  record.size = 0;
+  fields (record, values...);
+  r.head.store (head + 1, std::memory_order_release);
+}
+
+template <typename... Fields>
+void Log::debug (const char * event, const Fields &... fields)
+{
+  write (DEBUG, event, fields...);
+}
+
+template <typename... Fields>
+void Log::info (const char * event, const Fields &... fields)
+{
+  write (INFO, event, fields...);
+}
+
+template <typename... Fields>
+void Log::warning (const char * event, const Fields &... fields)
+{
+  write (WARNING, event, fields...);
+}
+
+template <typename... Fields>
+void Log::severe (const char * event, const Fields &... fields)
+{
+  write (SEVERE, event, fields...);
+}
+
+inline void Log::drain ()
+{
+  std::unordered_map<const char *, Repeat> repeats;
+  std::string out;
+  std::vector<std::shared_ptr<Ring>> rings;
+
+  for (bool running = true; running; )
+  {
+    {
+      std::unique_lock<std::mutex> lock {s_mutex};
+      s_stop.wait_for (lock, std::chrono::milliseconds {10}, [] { return ! s_running; });
+      running = s_running;
+      rings = s_rings;
+    }
+
+    // Anneau par anneau : l'ordre n'est garanti qu'au sein d'un thread.
+    for (const std::shared_ptr<Ring> & r : rings)
+    {
+      std::uint64_t tail = r->tail.load (std::memory_order_relaxed);
+      std::uint64_t head = r->head.load (std::memory_order_acquire);
+      for (; tail != head; ++tail)
+      {
+        const Record & record = r->records [tail & (CAPACITY - 1)];
+        Repeat & repeat = repeats [record.event];
+        std::int64_t second = record.time / 1000;
+        if (second != repeat.second)
+        {
+          if (repeat.suppressed != 0)
+            line (out, repeat.second * 1000 + 999, repeat.level, record.event,
+                  " supprimés=" + std::to_string (repeat.suppressed));
+          repeat = Repeat {second, 0, 0, record.level};
+        }
+        if (++repeat.count > REPEAT_LIMIT)
+          ++repeat.suppressed;
+        else
+          line (out, record.time, record.level, record.event, std::string_view {record.text, record.size});
+      }
+      r->tail.store (tail, std::memory_order_release);
+
+      if (std::uint64_t dropped = r->dropped.exchange (0, std::memory_order_relaxed))
+        line (out, std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::system_clock::now ().time_since_epoch ()).count (),
+              WARNING, "Journal saturé", " perdus=" + std::to_string (dropped));
+    }
+
+    // Répétitions d'une seconde terminée (ou toutes, à l'arrêt).
+    std::int64_t now = std::chrono::duration_cast<std::chrono::seconds> (std::chrono::system_clock::now ().time_since_epoch ()).count ();
+    flush (repeats, running ? now : INT64_MAX, out);
+
+    if (! out.empty ())
+    {
+      std::fwrite (out.data (), 1, out.size (), s_output);
+      std::fflush (s_output);
+      out.clear ();
+    }
+  }
+}
+
+inline void Log::flush (std::unordered_map<const char *, Repeat> & repeats, std::int64_t second, std::string & out)
+{
+  for (auto it = repeats.begin (); it != repeats.end (); )
+  {
+    Repeat & repeat = it->second;
+    if (repeat.second >= second)
+    {
+      ++it;
+      continue;
+    }
+    if (repeat.suppressed != 0)
+      line (out, repeat.second * 1000 + 999, repeat.level, it->first,
+            " supprimés=" + std::to_string (repeat.suppressed));
+    it = repeats.erase (it);
+  }
+}
+
+inline void Log::line (std::string & out, std::int64_t time, Level level, const char * event, std::string_view text)
+{
+  // "AAAA-MM-JJ hh:mm:ss.mmm NIVEAU événement clé=valeur..." (heure locale ;
+  // seul le thread de fond appelle localtime).
+  std::time_t seconds = static_cast<std::time_t> (time / 1000);
+  char date [32];
+  std::size_t n = std::strftime (date, sizeof (date), "%Y-%m-%d %H:%M:%S", std::localtime (&seconds));
+  std::snprintf (date + n, sizeof (date) - n, ".%03d ", static_cast<int> (time % 1000));
+
+  out += date;
+  out += name (level);
+  out += ' ';
+  out += event;
+  out += text;
+  out += '\n';
+}
+
+#endif // LOG_HPP
@@ -0,0 +1,347 @@
+#ifndef MAILBOX_HPP
+#define MAILBOX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <asio.hpp>
+#include "log.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// Mailbox /////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Boîtes aux lettres des alias absents (messages privés en attente).
+// Chaque boîte est une seule chaîne de lignes "expéditeur contenu" ; au-delà
+// du seuil mémoire, les plus grosses boîtes sont vidées dans des fichiers du
+// répertoire de débordement (un fichier par alias, nommé par une empreinte
+// de l'alias qu'il contient en première ligne, relu au démarrage) jusqu'à la
+// moitié du seuil. Écritures et relectures passent par un fil dédié : le fil
+// du serveur ("owner") ne touche jamais au disque. Nombre de boîtes et
+// octets sur disque sont bornés : au-delà, un dépôt est refusé.
+class Mailbox
+{
+  private:
+    struct Box
+    {
+      std::string lines;
+      std::size_t count = 0;
+      // Messages les plus anciens, sur disque (ou en cours d'écriture), et
+      // leur taille.
+      std::size_t spilled = 0;
+      std::size_t disk = 0;
+    };
+
+    asio::any_io_executor m_owner;
+    std::unordered_map<std::string, Box> m_boxes;
+    // Messages par alias (0 : boîtes désactivées), nombre de boîtes ;
+    // octets en mémoire et sur disque, et leurs limites.
+    std::size_t m_capacity;
+    std::size_t m_max_boxes;
+    std::size_t m_limit;
+    std::size_t m_memory;
+    std::size_t m_disk_limit;
+    std::size_t m_disk;
+    std::filesystem::path m_directory;
+    // Fichiers de débordement par empreinte, et leur alias (deux alias de
+    // même empreinte : le second reste en mémoire).
+    std::unordered_map<std::uint64_t, std::string> m_files;
+    // Fil du disque (démarré s'il y a un répertoire de débordement) ;
+    // lignes dont l'écriture a échoué, par alias (fil du disque seulement) :
+    // remises avec le fichier, les suivantes les rejoignent.
+    asio::io_context m_context;
+    asio::executor_work_guard<asio::io_context::executor_type> m_guard;
+    std::thread m_thread;
+    std::unordered_map<std::string, std::string> m_unwritten;
+
+  public:
+    Mailbox (asio::any_io_executor owner, std::size_t capacity, std::size_t boxes, std::size_t memory, std::size_t disk, const std::string & directory);
+    ~Mailbox ();
+    bool enabled () const;
+    // Fil du disque (non démarré sans débordement).
+    std::thread & thread ();
+    bool has (const std::string & alias) const;
+    // Dépôt d'un message ; faux si la boîte est pleine, s'il faudrait une
+    // boîte de plus que la limite, si mémoire et disque sont pleins (ou si
+    // les boîtes sont désactivées).
+    bool store (const std::string & alias, const std::string & sender, const std::string & content);
+    // Retrait de tous les messages, du plus ancien au plus récent :
+    // "handler (std::vector<std::string>)" appelé tout de suite pour une
+    // boîte en mémoire, plus tard (fil du serveur) pour une boîte débordée.
+    template <typename Handler>
+    void take (const std::string & alias, Handler && handler);
+    // Messages retirés mais non remis, rendus en tête de leur boîte.
+    void restore (const std::string & alias, const std::vector<std::string> & messages);
+
+  private:
+    static std::uint64_t hash (const std::string & alias);
+    std::filesystem::path path (const std::string & alias) const;
+    static std::vector<std::string> split (const std::string & lines);
+    // Débordement des plus grosses boîtes jusqu'à "target" octets en
+    // mémoire, dans la limite du disque.
+    void spill (std::size_t target);
+    bool spill (const std::string & alias, Box &);
+    void load ();
+};
+
+inline Mailbox::Mailbox (asio::any_io_executor owner, std::size_t capacity, std::size_t boxes, std::size_t memory, std::size_t disk, const std::string & directory) :
+  m_owner {std::move (owner)},
+  m_boxes {},
+  m_capacity {capacity},
+  m_max_boxes {boxes},
+  m_limit {memory},
+  m_memory {0},
+  m_disk_limit {directory.empty () ? 0 : disk},
+  m_disk {0},
+  m_directory {directory},
+  m_files {},
+  m_context {1},
+  m_guard {asio::make_work_guard (m_context)},
+  m_thread {},
+  m_unwritten {}
+{
+  if (! enabled () || m_directory.empty ()) return;
+
+  load ();
+  m_thread = std::thread {[this] { m_context.run (); }};
+}
+
+inline Mailbox::~Mailbox ()
+{
+  // Écritures en attente terminées avant l'arrêt.
+  m_guard.reset ();
+  if (m_thread.joinable ())
+    m_thread.join ();
+}
+
+inline bool Mailbox::enabled () const
+{
+  return m_capacity != 0;
+}
+
+inline std::thread & Mailbox::thread ()
+{
+  return m_thread;
+}
+
+inline bool Mailbox::has (const std::string & alias) const
+{
+  return ! m_boxes.empty () && m_boxes.count (alias) != 0;
+}
+
+inline bool Mailbox::store (const std::string & alias, const std::string & sender, const std::string & content)
+{
+  if (! enabled ()) return false;
+
+  auto it = m_boxes.find (alias);
+  if (it == m_boxes.end () && m_boxes.size () >= m_max_boxes) return false;
+  if (it != m_boxes.end () && it->second.count + it->second.spilled >= m_capacity) return false;
+
+  // Place faite avant le dépôt : boîtes débordées jusqu'à la moitié du
+  // seuil (pas un débordement par dépôt une fois le seuil atteint).
+  std::size_t size = sender.size () + content.size () + 2;
+  if (m_memory + size > m_limit)
+    spill (m_limit / 2 > size ? m_limit / 2 - size : 0);
+  if (m_memory + size > m_limit) return false;
+
+  Box & box = it != m_boxes.end () ? it->second : m_boxes [alias];
+  box.lines += sender;
+  box.lines += ' ';
+  box.lines += content;
+  box.lines += '\n';
+  m_memory += size;
+  ++box.count;
+  return true;
+}
+
+template <typename Handler>
+void Mailbox::take (const std::string & alias, Handler && handler)
+{
+  auto it = m_boxes.find (alias);
+  if (it == m_boxes.end ())
+  {
+    handler (std::vector<std::string> {});
+    return;
+  }
+
+  Box box = std::move (it->second);
+  m_boxes.erase (it);
+  m_memory -= box.lines.size ();
+  std::vector<std::string> messages = split (box.lines);
+  if (box.spilled == 0)
+  {
+    handler (std::move (messages));
+    return;
+  }
+
+  // Débordement d'abord (messages plus anciens), lu après les écritures
+  // déjà confiées au fil du disque ; résultat rendu au fil du serveur.
+  m_disk -= box.disk;
+  m_files.erase (hash (alias));
+  asio::post (m_context, [this, alias, path = path (alias), memory = std::move (messages), handler = std::forward<Handler> (handler)] () mutable
+  {
+    std::vector<std::string> messages;
+    {
+      std::ifstream file {path};
+      std::string line;
+      std::getline (file, line);
+      while (std::getline (file, line))
+        messages.push_back (line);
+    }
+    std::error_code ec;
+    std::filesystem::remove (path, ec);
+
+    auto unwritten = m_unwritten.find (alias);
+    if (unwritten != m_unwritten.end ())
+    {
+      for (std::string & line : split (unwritten->second))
+        messages.push_back (std::move (line));
+      m_unwritten.erase (unwritten);
+    }
+    for (std::string & line : memory)
+      messages.push_back (std::move (line));
+
+    asio::post (m_owner, [messages = std::move (messages), handler = std::move (handler)] () mutable
+    {
+      handler (std::move (messages));
+    });
+  });
+}
+
+inline void Mailbox::restore (const std::string & alias, const std::vector<std::string> & messages)
+{
+  // Hors limites : ces messages étaient déjà comptés.
+  std::string lines;
+  for (const std::string & message : messages)
+  {
+    lines += message;
+    lines += '\n';
+  }
+  Box & box = m_boxes [alias];
+  box.lines.insert (0, lines);
+  box.count += messages.size ();
+  m_memory += lines.size ();
+}
+
+inline std::uint64_t Mailbox::hash (const std::string & alias)
+{
+  // FNV-1a 64 bits : stable d'une exécution à l'autre.
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : alias)
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  return hash;
+}
+
+inline std::filesystem::path Mailbox::path (const std::string & alias) const
+{
+  // Alias quelconque (longueur, caractères) : nom de longueur fixe.
+  char name [24];
+  std::snprintf (name, sizeof name, "%016llx.mbox", static_cast<unsigned long long> (hash (alias)));
+  return m_directory / name;
+}
+
+inline std::vector<std::string> Mailbox::split (const std::string & lines)
+{
+  std::vector<std::string> messages;
+  std::string::size_type begin = 0, eol;
+  while ((eol = lines.find ('\n', begin)) != std::string::npos)
+  {
+    messages.emplace_back (lines, begin, eol - begin);
+    begin = eol + 1;
+  }
+  return messages;
+}
+
+inline void Mailbox::spill (std::size_t target)
+{
+  if (m_disk_limit == 0) return;
+
+  // Boîtes de la plus grosse à la plus petite (un seul tri par
+  // débordement).
+  std::vector<std::pair<std::size_t, std::unordered_map<std::string, Box>::iterator>> boxes;
+  for (auto it = m_boxes.begin (); it != m_boxes.end (); ++it)
+    if (! it->second.lines.empty ())
+      boxes.emplace_back (it->second.lines.size (), it);
+  std::sort (boxes.begin (), boxes.end (), [] (const auto & a, const auto & b) { return a.first > b.first; });
+
+  for (auto & [size, it] : boxes)
+  {
+    if (m_memory <= target) break;
+    if (m_disk + size > m_disk_limit) continue;
+    spill (it->first, it->second);
+  }
+}
+
+inline bool Mailbox::spill (const std::string & alias, Box & box)
+{
+  auto file = m_files.emplace (hash (alias), alias).first;
+  if (file->second != alias) return false;
+
+  m_memory -= box.lines.size ();
+  m_disk += box.lines.size ();
+  box.disk += box.lines.size ();
+  box.spilled += box.count;
+  box.count = 0;
+
+  // Ajout au fichier de l'alias sur le fil du disque, dans l'ordre des
+  // dépôts. Échec : lignes gardées en mémoire (toujours comptées sur le
+  // disque), remises avec le fichier.
+  asio::post (m_context, [this, alias, path = path (alias), lines = std::move (box.lines)]
+  {
+    auto unwritten = m_unwritten.find (alias);
+    if (unwritten == m_unwritten.end ())
+    {
+      std::error_code ec;
+      std::filesystem::create_directories (m_directory, ec);
+      bool fresh = ! std::filesystem::exists (path, ec);
+      std::ofstream file {path, std::ios::app};
+      if (fresh) file << alias << '\n';
+      if ((file << lines).flush ()) return;
+
+      Log::warning ("Débordement impossible", "fichier", path.string ());
+      unwritten = m_unwritten.emplace (alias, std::string {}).first;
+    }
+    unwritten->second += lines;
+  });
+  box.lines = std::string {};
+  return true;
+}
+
+inline void Mailbox::load ()
+{
+  // Boîtes débordées lors d'une exécution précédente : alias en première
+  // ligne, puis les messages.
+  std::error_code ec;
+  for (const auto & entry : std::filesystem::directory_iterator (m_directory, ec))
+  {
+    if (entry.path ().extension () != ".mbox") continue;
+
+    std::ifstream file {entry.path ()};
+    std::string alias, line;
+    if (! std::getline (file, alias) || entry.path () != path (alias)) continue;
+
+    std::size_t count = 0, size = 0;
+    while (std::getline (file, line))
+    {
+      ++count;
+      size += line.size () + 1;
+    }
+    if (count != 0)
+    {
+      Box & box = m_boxes [alias];
+      box.spilled = count;
+      box.disk = size;
+      m_disk += size;
+      m_files.emplace (hash (alias), alias);
+    }
+  }
+}
+
+#endif // MAILBOX_HPP
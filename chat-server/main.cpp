@@ -2,18 +2,130 @@
 
 int usage ()
 {
-  std::cerr << "Usage: server <port>" << std::endl;
+  std::cerr << "Usage: server <port> [--node <nom>] [--cluster-port <port>] [--peer <hôte:port>]..."
+               " [--read-buffers <n>] [--trace <période>] [--trace-file <fichier>]"
+               " [--mailbox-size <n>] [--mailbox-boxes <n>] [--mailbox-memory <octets>] [--mailbox-dir <répertoire>]"
+               " [--mailbox-disk <octets>]"
+               " [--presence-window <ms>] [--resume-buffer <trames>] [--resume-grace <ms>]"
+               " [--unix <chemin>] [--history <messages>] [--search-results <n>]"
+               " [--tls <port> --tls-cert <pem> --tls-key <pem>] [--tls-threads <n>]"
+               " [--max-inline <octets>] [--log-file <fichier>] [--log-level debug|info|warning|severe]"
+               " [--metrics-interval <ms>] [--max-connections <n>] [--max-per-address <n>]"
+               " [--connect-rate <connexions/s>] [--connect-burst <n>] [--capture <fichier>]"
+               " [--io-cpus <cpus>] [--tls-cpus <cpus>] [--aux-cpus <cpus>] [--zerocopy <octets>]"
+               " [--busy-poll <µs>] [--socket-busy-poll <µs>]" << std::endl;
   return 1;
 }
 
 int main (int argc, char * argv [])
 {
-  if (argc != 2)
+  if (argc < 2 || argc % 2 != 0)
     return usage ();
 
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+  // Noyau sans io_uring (ou appels bloqués) : repli sur le serveur epoll,
+  // même chemin sans le suffixe "-uring".
+  if (! io_uring_available ())
+  {
+    std::string path {argv [0]};
+    std::string::size_type suffix = path.rfind ("-uring");
+    if (suffix != std::string::npos)
+    {
+      path.erase (suffix, 6);
+      std::cerr << "io_uring indisponible, repli sur " << path << std::endl;
+      ::execv (path.c_str (), argv);
+    }
+    std::cerr << "io_uring indisponible" << std::endl;
+    return 1;
+  }
+#endif
+
   try
   {
-    Server server (std::stoi (argv [1]));
+    // Options : paires "--nom valeur".
+    Server::Options options;
+    for (int i = 2; i < argc; i += 2)
+    {
+      std::string option {argv [i]};
+      std::string value {argv [i + 1]};
+
+      if (option == "--node")
+        options.node = value;
+      else if (option == "--cluster-port")
+        options.cluster_port = std::stoi (value);
+      else if (option == "--peer")
+        options.peers.push_back (value);
+      else if (option == "--read-buffers")
+        options.read_buffers = std::stoul (value);
+      else if (option == "--trace")
+        options.trace_period = std::stoul (value);
+      else if (option == "--trace-file")
+        options.trace_file = value;
+      else if (option == "--mailbox-size")
+        options.mailbox_size = std::stoul (value);
+      else if (option == "--mailbox-boxes")
+        options.mailbox_boxes = std::stoul (value);
+      else if (option == "--mailbox-memory")
+        options.mailbox_memory = std::stoul (value);
+      else if (option == "--mailbox-dir")
+        options.mailbox_dir = value;
+      else if (option == "--mailbox-disk")
+        options.mailbox_disk = std::stoul (value);
+      else if (option == "--presence-window")
+        options.presence_window_ms = std::stoul (value);
+      else if (option == "--resume-buffer")
+        options.resume_buffer = std::stoul (value);
+      else if (option == "--resume-grace")
+        options.resume_grace_ms = std::stoul (value);
+      else if (option == "--unix")
+        options.unix_path = value;
+      else if (option == "--history")
+        options.history = std::stoul (value);
+      else if (option == "--search-results")
+        options.search_results = std::stoul (value);
+      else if (option == "--tls")
+        options.tls_port = std::stoi (value);
+      else if (option == "--tls-cert")
+        options.tls_certificate = value;
+      else if (option == "--tls-key")
+        options.tls_key = value;
+      else if (option == "--tls-threads")
+        options.tls_threads = std::stoul (value);
+      else if (option == "--max-inline")
+        options.max_inline = std::stoul (value);
+      else if (option == "--log-file")
+        options.log_file = value;
+      else if (option == "--log-level")
+        options.log_level = Log::parse (value);
+      else if (option == "--metrics-interval")
+        options.metrics_interval_ms = std::stoul (value);
+      else if (option == "--max-connections")
+        options.max_connections = std::stoul (value);
+      else if (option == "--max-per-address")
+        options.max_per_address = std::stoul (value);
+      else if (option == "--connect-rate")
+        options.connect_rate = std::stod (value);
+      else if (option == "--connect-burst")
+        options.connect_burst = std::stod (value);
+      else if (option == "--capture")
+        options.capture_file = value;
+      else if (option == "--io-cpus")
+        options.io_cpus = value;
+      else if (option == "--tls-cpus")
+        options.tls_cpus = value;
+      else if (option == "--aux-cpus")
+        options.aux_cpus = value;
+      else if (option == "--zerocopy")
+        options.zerocopy = std::stoul (value);
+      else if (option == "--busy-poll")
+        options.busy_poll_us = std::stoul (value);
+      else if (option == "--socket-busy-poll")
+        options.socket_busy_poll_us = std::stoul (value);
+      else
+        return usage ();
+    }
+
+    Server server (std::stoi (argv [1]), options);
     server.start ();
   }
   catch (std::exception & e)
@@ -0,0 +1,84 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Histogram ///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Histogramme log-linéaire des latences (microsecondes) : 16 sous-classes par
+// puissance de deux, soit une précision relative d'environ 6 %.
+class Histogram
+{
+  private:
+    static const int SUB = 16;
+    std::vector<std::uint64_t> m_buckets;
+    std::uint64_t m_count;
+
+    static int index (std::uint64_t us);
+    static std::uint64_t value (int index);
+
+  public:
+    Histogram ();
+    void add (std::uint64_t us);
+    std::uint64_t count () const;
+    std::uint64_t percentile (double p) const;
+    void clear ();
+};
+
+inline Histogram::Histogram () :
+  m_buckets (64 * SUB, 0),
+  m_count {0}
+{
+}
+
+inline int Histogram::index (std::uint64_t us)
+{
+  if (us < SUB) return static_cast<int> (us);
+  int e = 63 - __builtin_clzll (us);
+  int m = static_cast<int> ((us >> (e - 4)) & (SUB - 1));
+  return (e - 3) * SUB + m;
+}
+
+inline std::uint64_t Histogram::value (int index)
+{
+  if (index < SUB) return index;
+  int e = index / SUB + 3;
+  int m = index % SUB;
+  return static_cast<std::uint64_t> (SUB + m) << (e - 4);
+}
+
+inline void Histogram::add (std::uint64_t us)
+{
+  ++m_buckets [index (us)];
+  ++m_count;
+}
+
+inline std::uint64_t Histogram::count () const
+{
+  return m_count;
+}
+
+inline std::uint64_t Histogram::percentile (double p) const
+{
+  std::uint64_t rank = static_cast<std::uint64_t> (std::ceil (p * m_count));
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < m_buckets.size (); ++i)
+  {
+    seen += m_buckets [i];
+    if (seen >= rank && seen != 0) return value (static_cast<int> (i));
+  }
+  return 0;
+}
+
+inline void Histogram::clear ()
+{
+  std::fill (m_buckets.begin (), m_buckets.end (), 0);
+  m_count = 0;
+}
+
+#endif // METRICS_HPP
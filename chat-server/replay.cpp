@@ -0,0 +1,452 @@
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <asio.hpp>
+#include "capture.hpp"
+#include "metrics.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// Connection //////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+typedef std::chrono::steady_clock Clock;
+
+// Compteurs globaux (contexte mono-thread).
+struct Stats
+{
+  // Retard de chaque enregistrement sur sa date prévue (microsecondes).
+  Histogram lateness;
+  std::uint64_t connections = 0;
+  std::uint64_t lines = 0;
+  std::uint64_t received = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t errors = 0;
+  std::uint64_t failed = 0;
+  std::size_t open = 0;
+  // Durée du rejeu (dernier enregistrement joué), puis jusqu'à la fermeture
+  // de toutes les connexions par le serveur.
+  double played = 0.0;
+  double drained = 0.0;
+};
+
+// Jetons de session : jeton capturé vers jeton attribué par le serveur
+// rejoué ("/resume" réécrit).
+typedef std::unordered_map<std::string, std::string> Tokens;
+
+// Connexion rejouée : lignes capturées envoyées dans l'ordre (en attente
+// jusqu'à l'établissement), réponses lues et comptées. Fermeture capturée :
+// envoi fermé, réponses lues jusqu'à la fermeture par le serveur.
+class Connection : public std::enable_shared_from_this<Connection>
+{
+  private:
+    asio::ip::tcp::socket m_socket;
+    asio::streambuf m_buffer;
+    std::deque<std::string> m_queue;
+    Stats & m_stats;
+    Tokens & m_tokens;
+    // Jeton de la capture, jeton attribué par le serveur rejoué.
+    std::string m_captured;
+    std::string m_issued;
+    bool m_connected;
+    bool m_closing;
+
+  public:
+    Connection (asio::io_context &, Stats &, Tokens &);
+    void start (const asio::ip::tcp::endpoint &);
+    void write (const std::string &);
+    void session (const std::string & token);
+    // Fermeture après l'envoi des lignes en attente.
+    void close ();
+    void stop ();
+
+  private:
+    void read ();
+    void process (const std::string &);
+    void flush ();
+    void finish ();
+    void pair ();
+};
+
+Connection::Connection (asio::io_context & context, Stats & stats, Tokens & tokens) :
+  m_socket {context},
+  m_buffer {},
+  m_queue {},
+  m_stats (stats),
+  m_tokens (tokens),
+  m_captured {},
+  m_issued {},
+  m_connected {false},
+  m_closing {false}
+{
+}
+
+void Connection::start (const asio::ip::tcp::endpoint & endpoint)
+{
+  ++m_stats.connections;
+  ++m_stats.open;
+
+  auto self = shared_from_this ();
+  m_socket.async_connect (endpoint,
+    [this, self] (const std::error_code & ec)
+    {
+      if (ec)
+      {
+        ++m_stats.failed;
+        stop ();
+        return;
+      }
+      asio::error_code ignored;
+      m_socket.set_option (asio::ip::tcp::no_delay (true), ignored);
+
+      m_connected = true;
+      read ();
+      if (! m_queue.empty ())
+        flush ();
+      else if (m_closing)
+        finish ();
+    });
+}
+
+void Connection::write (const std::string & line)
+{
+  if (! m_socket.is_open ()) return;
+  ++m_stats.lines;
+
+  // Reprise : jeton capturé remplacé par celui du serveur rejoué.
+  std::string frame = line;
+  if (line.compare (0, 8, "/resume ") == 0)
+  {
+    std::string::size_type end = line.find (' ', 8);
+    auto it = m_tokens.find (line.substr (8, end == std::string::npos ? std::string::npos : end - 8));
+    if (it != m_tokens.end ())
+      frame = "/resume " + it->second + (end == std::string::npos ? "" : line.substr (end));
+  }
+
+  bool idle = m_queue.empty ();
+  m_queue.push_back (frame + '\n');
+  if (idle && m_connected) flush ();
+}
+
+void Connection::session (const std::string & token)
+{
+  m_captured = token;
+  pair ();
+}
+
+void Connection::pair ()
+{
+  if (! m_captured.empty () && ! m_issued.empty ())
+    m_tokens [m_captured] = m_issued;
+}
+
+void Connection::close ()
+{
+  m_closing = true;
+  if (m_connected && m_queue.empty ())
+    finish ();
+}
+
+void Connection::finish ()
+{
+  asio::error_code ec;
+  m_socket.shutdown (asio::ip::tcp::socket::shutdown_send, ec);
+  if (ec) stop ();
+}
+
+void Connection::stop ()
+{
+  if (! m_socket.is_open ()) return;
+  --m_stats.open;
+  asio::error_code ignored;
+  m_socket.close (ignored);
+}
+
+void Connection::read ()
+{
+  auto self = shared_from_this ();
+  asio::async_read_until (m_socket, m_buffer, '\n',
+    [this, self] (const std::error_code & ec, std::size_t)
+    {
+      if (ec)
+      {
+        stop ();
+        return;
+      }
+      std::string data {asio::buffers_begin (m_buffer.data ()), asio::buffers_end (m_buffer.data ())};
+      std::string::size_type begin = 0, eol;
+      while ((eol = data.find ('\n', begin)) != std::string::npos)
+      {
+        process (data.substr (begin, eol - begin));
+        begin = eol + 1;
+      }
+      m_buffer.consume (begin);
+      read ();
+    });
+}
+
+void Connection::process (const std::string & line)
+{
+  ++m_stats.received;
+  m_stats.bytes += line.size () + 1;
+
+  if (line.compare (0, 9, "#session ") == 0)
+  {
+    m_issued = line.substr (9);
+    pair ();
+  }
+  else if (line.compare (0, 7, "#error ") == 0)
+    ++m_stats.errors;
+}
+
+void Connection::flush ()
+{
+  auto self = shared_from_this ();
+  asio::async_write (m_socket, asio::buffer (m_queue.front ()),
+    [this, self] (const std::error_code & ec, std::size_t)
+    {
+      if (ec)
+      {
+        m_queue.clear ();
+        stop ();
+        return;
+      }
+      m_queue.pop_front ();
+      if (! m_queue.empty ())
+        flush ();
+      else if (m_closing)
+        finish ();
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Player //////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Lecture de la capture : chaque enregistrement est joué à sa date divisée
+// par "speed" (0 : sans attendre), tous ceux qui sont échus d'un coup.
+class Player
+{
+  private:
+    asio::io_context & m_context;
+    asio::steady_timer m_timer;
+    asio::ip::tcp::endpoint m_endpoint;
+    const std::vector<Capture::Record> & m_records;
+    double m_speed;
+    Stats & m_stats;
+    Tokens m_tokens;
+    std::map<std::uint32_t, std::shared_ptr<Connection>> m_connections;
+    std::size_t m_next;
+    Clock::time_point m_begin;
+
+  public:
+    Player (asio::io_context &, const asio::ip::tcp::endpoint &, const std::vector<Capture::Record> &, double speed, Stats &);
+    void start ();
+    void stop ();
+
+  private:
+    Clock::time_point due (const Capture::Record &) const;
+    void play ();
+    void apply (const Capture::Record &);
+    // Fin : attente des fermetures (une seconde au plus).
+    void drain (Clock::time_point deadline);
+};
+
+Player::Player (asio::io_context & context, const asio::ip::tcp::endpoint & endpoint,
+                const std::vector<Capture::Record> & records, double speed, Stats & stats) :
+  m_context (context),
+  m_timer {context},
+  m_endpoint {endpoint},
+  m_records (records),
+  m_speed {speed},
+  m_stats (stats),
+  m_tokens {},
+  m_connections {},
+  m_next {0},
+  m_begin {}
+{
+}
+
+void Player::start ()
+{
+  m_begin = Clock::now ();
+  play ();
+}
+
+void Player::stop ()
+{
+  m_timer.cancel ();
+  for (auto & entry : m_connections)
+    entry.second->stop ();
+  m_connections.clear ();
+}
+
+Clock::time_point Player::due (const Capture::Record & record) const
+{
+  if (m_speed == 0.0) return m_begin;
+  return m_begin + std::chrono::duration_cast<Clock::duration> (std::chrono::duration<double, std::micro> (record.time / m_speed));
+}
+
+void Player::play ()
+{
+  // Vitesse maximale : rendre la main à la boucle par lots (lectures et
+  // écritures progressent pendant le rejeu).
+  const std::size_t BATCH = 256;
+  Clock::time_point now = Clock::now ();
+  std::size_t played = 0;
+  while (m_next < m_records.size () && due (m_records [m_next]) <= now && (m_speed != 0.0 || played < BATCH))
+  {
+    const Capture::Record & record = m_records [m_next++];
+    if (m_speed != 0.0)
+      m_stats.lateness.add (std::chrono::duration_cast<std::chrono::microseconds> (now - due (record)).count ());
+    apply (record);
+    ++played;
+  }
+
+  if (m_next == m_records.size ())
+  {
+    m_stats.played = std::chrono::duration<double> (now - m_begin).count ();
+    drain (now + std::chrono::seconds (1));
+    return;
+  }
+
+  if (m_speed == 0.0)
+    asio::post (m_context, [this] { play (); });
+  else
+  {
+    m_timer.expires_at (due (m_records [m_next]));
+    m_timer.async_wait ([this] (const std::error_code & ec) { if (! ec) play (); });
+  }
+}
+
+void Player::drain (Clock::time_point deadline)
+{
+  Clock::time_point now = Clock::now ();
+  if (m_stats.open == 0 || now >= deadline)
+  {
+    m_stats.drained = std::chrono::duration<double> (now - m_begin).count ();
+    stop ();
+    return;
+  }
+
+  m_timer.expires_after (std::chrono::milliseconds (1));
+  m_timer.async_wait ([this, deadline] (const std::error_code & ec) { if (! ec) drain (deadline); });
+}
+
+void Player::apply (const Capture::Record & record)
+{
+  if (record.kind == Capture::OPEN)
+  {
+    auto connection = std::make_shared<Connection> (m_context, m_stats, m_tokens);
+    m_connections [record.connection] = connection;
+    connection->start (m_endpoint);
+    return;
+  }
+
+  auto it = m_connections.find (record.connection);
+  // Connexion ouverte avant le début de la capture : ignorée.
+  if (it == m_connections.end ()) return;
+
+  switch (record.kind)
+  {
+    case Capture::LINE:
+      it->second->write (record.text);
+      break;
+    case Capture::SESSION:
+      it->second->session (record.text);
+      break;
+    case Capture::CLOSE:
+      it->second->close ();
+      m_connections.erase (it);
+      break;
+    default:
+      break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main ////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+int usage ()
+{
+  std::cerr << "Usage: replay <capture> <hôte:port> [--speed <facteur> | --max]" << std::endl;
+  return 1;
+}
+
+int main (int argc, char * argv [])
+{
+  if (argc < 3)
+    return usage ();
+
+  std::string path {argv [1]};
+  std::string target {argv [2]};
+  // 1 : temps réel ; 2 : deux fois plus vite ; 0 : sans attendre.
+  double speed = 1.0;
+
+  try
+  {
+    for (int i = 3; i < argc; ++i)
+    {
+      std::string option {argv [i]};
+      if (option == "--max")
+        speed = 0.0;
+      else if (option == "--speed" && i + 1 < argc)
+        speed = std::stod (argv [++i]);
+      else
+        return usage ();
+    }
+  }
+  catch (std::exception &)
+  {
+    return usage ();
+  }
+
+  std::string::size_type colon = target.rfind (':');
+  if (speed < 0.0 || colon == std::string::npos)
+    return usage ();
+
+  std::vector<Capture::Record> records;
+  try
+  {
+    records = Capture::load (path);
+  }
+  catch (std::exception & e)
+  {
+    std::cerr << e.what () << std::endl;
+    return 1;
+  }
+
+  asio::io_context context;
+  asio::ip::tcp::resolver resolver {context};
+  asio::ip::tcp::endpoint endpoint = resolver.resolve (target.substr (0, colon), target.substr (colon + 1)).begin ()->endpoint ();
+
+  Stats stats;
+  Player player {context, endpoint, records, speed, stats};
+  player.start ();
+  context.run ();
+
+  double captured = records.empty () ? 0.0 : records.back ().time / 1e6;
+
+  // Résultat : une ligne JSON.
+  std::cout << "{\"records\":" << records.size ()
+            << ",\"speed\":" << speed
+            << ",\"captured_s\":" << captured
+            << ",\"played_s\":" << stats.played
+            << ",\"drained_s\":" << stats.drained
+            << ",\"connections\":" << stats.connections
+            << ",\"failed\":" << stats.failed
+            << ",\"lines\":" << stats.lines
+            << ",\"received\":" << stats.received
+            << ",\"bytes_received\":" << stats.bytes
+            << ",\"errors\":" << stats.errors
+            << ",\"late_p50_us\":" << stats.lateness.percentile (0.50)
+            << ",\"late_p99_us\":" << stats.lateness.percentile (0.99)
+            << "}" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef ROSTER_HPP
+#define ROSTER_HPP
+
+#include <string>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////////////////
+// Roster //////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Liste des alias en photographie : lignes rendues une fois par changement,
+// puis partagées par chaque "#users" et chaque "/list". Lue et publiée par le
+// seul fil du serveur (aucun autre fil ne consulte les alias).
+class Roster
+{
+  public:
+    struct Snapshot
+    {
+      // Lignes déjà rendues : "#users <numéro>:<alias> ... :<distant>",
+      // "#list <alias> ...".
+      std::string users;
+      std::string list;
+    };
+
+  private:
+    Snapshot m_current;
+
+  public:
+    const Snapshot & current () const;
+    void publish (Snapshot);
+};
+
+inline const Roster::Snapshot & Roster::current () const
+{
+  return m_current;
+}
+
+inline void Roster::publish (Snapshot snapshot)
+{
+  m_current = std::move (snapshot);
+}
+
+#endif // ROSTER_HPP
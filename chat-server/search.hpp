@@ -0,0 +1,337 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <asio.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+// Index ///////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Historique des messages publics et index inversé : pour chaque mot, la
+// liste croissante des messages qui le contiennent, en écarts codés sur un
+// nombre variable d'octets (7 bits par octet), par blocs de BLOCK numéros
+// décodables séparément : une requête part des blocs les plus récents et
+// s'arrête au "limit"-ième résultat. Les "capacity" derniers messages sont
+// conservés ; les listes sont reconstruites (coût amorti) quand les messages
+// oubliés y sont aussi nombreux que les messages conservés.
+// Aucune synchronisation : l'index appartient à un seul fil.
+class Index
+{
+  public:
+    struct Hit
+    {
+      std::int64_t time;
+      std::string sender;
+      std::string text;
+    };
+
+    // Mots ignorés au-delà de cette longueur.
+    static const std::size_t MAX_TERM = 64;
+    static const std::size_t BLOCK = 128;
+
+  private:
+    // Bloc : premier numéro (non codé), position du suivant dans "bytes".
+    struct Block
+    {
+      std::uint64_t first;
+      std::size_t offset;
+    };
+
+    struct Posting
+    {
+      std::string bytes;
+      std::vector<Block> blocks;
+      std::uint64_t last = 0;
+      std::size_t count = 0;
+    };
+
+    // Parcours d'une liste par numéros décroissants (bloc décodé à la demande).
+    struct Cursor
+    {
+      const Posting * posting;
+      std::size_t block;
+      std::vector<std::uint64_t> ids;
+    };
+
+    std::deque<Hit> m_documents;
+    std::size_t m_capacity;
+    // Numéro du premier message conservé (numérotation à partir de 1) ;
+    // premier message couvert par les listes.
+    std::uint64_t m_first;
+    std::uint64_t m_base;
+    std::unordered_map<std::string, Posting> m_postings;
+
+  public:
+    explicit Index (std::size_t capacity);
+    std::size_t size () const;
+    void add (std::int64_t time, const std::string & sender, const std::string & text);
+    // Messages contenant tous les mots de "terms" : les "limit" plus récents,
+    // du plus ancien au plus récent.
+    std::vector<Hit> query (const std::string & terms, std::size_t limit) const;
+    // Découpage en mots (lettres et chiffres, ASCII en minuscules ; les
+    // octets UTF-8 non ASCII font partie des mots).
+    static std::vector<std::string> tokens (const std::string &);
+
+  private:
+    void insert (std::uint64_t id, const std::string & text);
+    void compact ();
+    static void load (Cursor &, std::size_t block);
+    static bool contains (Cursor &, std::uint64_t id);
+    static void encode (std::string &, std::uint64_t);
+    static std::uint64_t decode (const std::string &, std::size_t & position);
+};
+
+inline Index::Index (std::size_t capacity) :
+  m_documents {},
+  m_capacity {capacity},
+  m_first {1},
+  m_base {1},
+  m_postings {}
+{
+}
+
+inline std::size_t Index::size () const
+{
+  return m_documents.size ();
+}
+
+inline void Index::add (std::int64_t time, const std::string & sender, const std::string & text)
+{
+  if (m_capacity == 0) return;
+
+  std::uint64_t id = m_first + m_documents.size ();
+  m_documents.push_back (Hit {time, sender, text});
+  insert (id, text);
+
+  if (m_documents.size () > m_capacity)
+  {
+    m_documents.pop_front ();
+    ++m_first;
+    if (m_first - m_base >= m_capacity)
+      compact ();
+  }
+}
+
+inline std::vector<Index::Hit> Index::query (const std::string & terms, std::size_t limit) const
+{
+  std::vector<Hit> hits;
+  std::vector<std::string> words = tokens (terms);
+  std::sort (words.begin (), words.end ());
+  words.erase (std::unique (words.begin (), words.end ()), words.end ());
+  if (words.empty ()) return hits;
+
+  // Listes de la plus courte à la plus longue.
+  std::vector<const Posting *> postings;
+  for (const std::string & word : words)
+  {
+    auto it = m_postings.find (word);
+    if (it == m_postings.end ()) return hits;
+    postings.push_back (&it->second);
+  }
+  std::sort (postings.begin (), postings.end (),
+    [] (const Posting * a, const Posting * b) { return a->count < b->count; });
+
+  // Candidats de la liste la plus courte, du plus récent au plus ancien,
+  // présents dans toutes les autres.
+  std::vector<Cursor> cursors;
+  for (const Posting * posting : postings)
+    cursors.push_back (Cursor {posting, posting->blocks.size (), {}});
+
+  std::vector<std::uint64_t> ids;
+  Cursor & primary = cursors [0];
+  for (std::size_t block = primary.posting->blocks.size (); block-- > 0 && ids.size () < limit; )
+  {
+    load (primary, block);
+    for (auto it = primary.ids.rbegin (); it != primary.ids.rend () && ids.size () < limit; ++it)
+    {
+      if (*it < m_first) break;
+      bool all = true;
+      for (std::size_t i = 1; i < cursors.size () && all; ++i)
+        all = contains (cursors [i], *it);
+      if (all) ids.push_back (*it);
+    }
+    if (primary.ids.empty () || primary.ids.front () < m_first) break;
+  }
+
+  for (auto it = ids.rbegin (); it != ids.rend (); ++it)
+    hits.push_back (m_documents [*it - m_first]);
+  return hits;
+}
+
+inline void Index::load (Cursor & cursor, std::size_t block)
+{
+  const Posting & posting = *cursor.posting;
+  std::size_t end = block + 1 < posting.blocks.size () ? posting.blocks [block + 1].offset : posting.bytes.size ();
+  std::size_t position = posting.blocks [block].offset;
+  std::uint64_t id = posting.blocks [block].first;
+
+  cursor.block = block;
+  cursor.ids.clear ();
+  cursor.ids.push_back (id);
+  while (position < end)
+  {
+    id += decode (posting.bytes, position);
+    cursor.ids.push_back (id);
+  }
+}
+
+inline bool Index::contains (Cursor & cursor, std::uint64_t id)
+{
+  // Numéros demandés décroissants : le bloc courant ne fait que reculer.
+  const std::vector<Block> & blocks = cursor.posting->blocks;
+  std::size_t block = cursor.block;
+  while (block > 0 && (block == blocks.size () || blocks [block].first > id))
+    --block;
+  if (blocks.empty () || blocks [block].first > id) return false;
+
+  if (block != cursor.block || cursor.ids.empty ())
+    load (cursor, block);
+  return std::binary_search (cursor.ids.begin (), cursor.ids.end (), id);
+}
+
+inline std::vector<std::string> Index::tokens (const std::string & text)
+{
+  std::vector<std::string> words;
+  std::string word;
+  for (std::size_t i = 0; i <= text.size (); ++i)
+  {
+    unsigned char c = i < text.size () ? text [i] : ' ';
+    if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80)
+      word += static_cast<char> (c);
+    else if (c >= 'A' && c <= 'Z')
+      word += static_cast<char> (c - 'A' + 'a');
+    else if (! word.empty ())
+    {
+      if (word.size () <= MAX_TERM) words.push_back (word);
+      word.clear ();
+    }
+  }
+  return words;
+}
+
+inline void Index::insert (std::uint64_t id, const std::string & text)
+{
+  for (const std::string & word : tokens (text))
+  {
+    Posting & posting = m_postings [word];
+    // Mot répété dans le même message.
+    if (posting.last == id) continue;
+    if (posting.count % BLOCK == 0)
+      posting.blocks.push_back (Block {id, posting.bytes.size ()});
+    else
+      encode (posting.bytes, id - posting.last);
+    posting.last = id;
+    ++posting.count;
+  }
+}
+
+inline void Index::compact ()
+{
+  m_postings.clear ();
+  m_base = m_first;
+  for (std::size_t i = 0; i < m_documents.size (); ++i)
+    insert (m_first + i, m_documents [i].text);
+}
+
+inline void Index::encode (std::string & bytes, std::uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    bytes += static_cast<char> ((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  bytes += static_cast<char> (value);
+}
+
+inline std::uint64_t Index::decode (const std::string & bytes, std::size_t & position)
+{
+  std::uint64_t value = 0;
+  for (int shift = 0; position < bytes.size (); shift += 7)
+  {
+    unsigned char byte = bytes [position++];
+    value |= static_cast<std::uint64_t> (byte & 0x7F) << shift;
+    if (byte < 0x80) break;
+  }
+  return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Search //////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Index sur un fil dédié : le fil principal y dépose les messages et les
+// requêtes sans attendre, une recherche longue ne retarde pas la diffusion.
+class Search
+{
+  private:
+    Index m_index;
+    asio::io_context m_context;
+    asio::executor_work_guard<asio::io_context::executor_type> m_guard;
+    std::thread m_thread;
+    bool m_enabled;
+
+  public:
+    // Messages conservés (0 : recherche désactivée, pas de fil).
+    explicit Search (std::size_t capacity);
+    ~Search ();
+    bool enabled () const;
+    // Fil de l'index (non démarré si la recherche est désactivée).
+    std::thread & thread ();
+    void add (std::int64_t time, const std::string & sender, const std::string & text);
+    // "handler (std::vector<Index::Hit>)" appelé sur le fil de l'index.
+    template <typename Handler>
+    void query (const std::string & terms, std::size_t limit, Handler && handler);
+};
+
+inline Search::Search (std::size_t capacity) :
+  m_index {capacity},
+  m_context {1},
+  m_guard {asio::make_work_guard (m_context)},
+  m_thread {},
+  m_enabled {capacity != 0}
+{
+  if (m_enabled)
+    m_thread = std::thread {[this] { m_context.run (); }};
+}
+
+inline Search::~Search ()
+{
+  m_guard.reset ();
+  m_context.stop ();
+  if (m_thread.joinable ())
+    m_thread.join ();
+}
+
+inline bool Search::enabled () const
+{
+  return m_enabled;
+}
+
+inline std::thread & Search::thread ()
+{
+  return m_thread;
+}
+
+inline void Search::add (std::int64_t time, const std::string & sender, const std::string & text)
+{
+  if (! m_enabled) return;
+  asio::post (m_context, [this, time, sender, text] { m_index.add (time, sender, text); });
+}
+
+template <typename Handler>
+void Search::query (const std::string & terms, std::size_t limit, Handler && handler)
+{
+  asio::post (m_context, [this, terms, limit, handler = std::forward<Handler> (handler)] () mutable
+  {
+    handler (m_index.query (terms, limit));
+  });
+}
+
+#endif // SEARCH_HPP
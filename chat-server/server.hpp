@@ -1,7 +1,37 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <list>
 #include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <iostream>
 #include <asio.hpp>
+#include "admission.hpp"
+#include "affinity.hpp"
+#include "capture.hpp"
+#include "clock.hpp"
+#include "log.hpp"
+#include "mailbox.hpp"
+#include "metrics.hpp"
+#include "roster.hpp"
+#include "search.hpp"
+#include "trace.hpp"
+#include "transport.hpp"
+#include "uring.hpp"
+#if defined(CHAT_TLS)
+#include "tls.hpp"
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 // Server //////////////////////////////////////////////////////////////////////
@@ -9,62 +39,501 @@
 
 class Server
 {
+  // Bancs d'essai (bench.cpp) et simulation (sim.cpp).
+  friend class Bench;
+  friend class Simulation;
+
   private:
     typedef asio::ip::tcp::socket Socket;
+    // Minuteries : horloge monotone, ou virtuelle en simulation.
+#if defined(CHAT_VIRTUAL_CLOCK)
+    typedef VirtualClock Clock;
+    typedef asio::basic_waitable_timer<VirtualClock, VirtualWaitTraits> Timer;
+#else
+    typedef std::chrono::steady_clock Clock;
+    typedef asio::steady_timer Timer;
+#endif
+
+    // Événements diffusés, auxquels un client peut renoncer ("/subscribe").
+    enum Event : std::uint32_t
+    {
+      MESSAGES = 1 << 0,
+      PRESENCE = 1 << 1,
+      RENAMES  = 1 << 2,
+      ALL_EVENTS = MESSAGES | PRESENCE | RENAMES
+    };
+
+    // Voies de la file d'envoi d'un client : réponses, erreurs et messages
+    // privés (CONTROL) passent devant la diffusion (BULK).
+    enum Lane { CONTROL, BULK, LANES };
 
     // Client vu du serveur (pointeurs intelligents).
     class Client : public std::enable_shared_from_this<Client>
     {
       private:
+        // Long message en cours d'envoi par fragments : texte partagé entre
+        // les destinataires, position du prochain fragment.
+        struct Fragmented
+        {
+          std::shared_ptr<const std::string> payload;
+          std::size_t offset;
+          std::uint32_t id;
+          // Liste "#users" : client inscrit après le dernier fragment.
+          bool roster = false;
+          // Message tracé (0 : non), écrit avec le dernier fragment.
+          std::uint64_t trace = 0;
+        };
+
+        // Message tracé en attente : trame de rang "frame" (depuis le début
+        // de la session) dans sa voie.
+        struct Traced
+        {
+          std::uint64_t trace;
+          Lane lane;
+          std::uint64_t frame;
+        };
+
+        // Fragment en cours d'écriture : en-tête, texte dans le message
+        // partagé, trame numérotée ou non.
+        struct Writing
+        {
+          std::shared_ptr<const std::string> payload;
+          std::string header;
+          asio::const_buffer text;
+          bool numbered = false;
+        };
+
         Server * m_server;
-        Socket m_socket;
-        asio::streambuf m_buffer;
+        std::unique_ptr<Transport> m_transport;
+        // Réveil de la boucle d'écriture ; fin de la boucle d'écriture.
+        Timer m_wakeup;
+        Timer m_done;
+        // Tampon de lecture emprunté au serveur (ou propre au client).
+        std::size_t m_slot;
+        std::vector<char> m_chunk;
+        // Ligne incomplète en attente de la lecture suivante.
+        std::string m_pending;
+        // Lignes en attente d'écriture par voie (date d'arrivée de la plus
+        // ancienne, trames ajoutées et retirées depuis le début) et lignes
+        // en cours d'écriture.
+        std::deque<std::string> m_queues [LANES];
+        Clock::time_point m_queued [LANES];
+        std::uint64_t m_enqueued [LANES];
+        std::uint64_t m_taken [LANES];
+        std::vector<std::string> m_sending;
+        // Longs messages en attente (un fragment par écriture, à tour de
+        // rôle), fragment en cours d'écriture (après "m_sending") ; numéro
+        // du dernier.
+        std::deque<Fragmented> m_fragmented;
+        Writing m_writing_fragment;
+        std::uint32_t m_fragment_id;
+        // Messages tracés parmi les lignes en attente.
+        std::vector<Traced> m_traces;
+        // Alias, numéro compact attribué au premier alias (conservé aux
+        // suivants), débuts de ligne "#msg" rendus à chaque alias : numéro
+        // seul, ou numéro et alias (présentation).
         std::string m_alias;
+        std::uint32_t m_id;
+        std::string m_prefix;
+        std::string m_introduction;
+        // Alias présenté à tous depuis le dernier changement ; liste des
+        // numéros ("#users") reçue, ou en fragments pas encore tous écrits
+        // (d'ici là, messages sous la forme longue : une ligne "#msg" ne
+        // double pas la liste).
+        bool m_introduced;
+        bool m_listed;
+        bool m_listing;
+        // Reprise de session : jeton, numéro de la dernière trame (rang de
+        // la ligne depuis "#session"), dernières trames écrites et délai de
+        // grâce après une coupure. Trames antérieures à la numérotation,
+        // encore en cours d'écriture ou en attente : ni conservées, ni
+        // rejouées.
+        std::string m_token;
+        std::uint64_t m_sequence;
+        std::deque<std::string> m_replay;
+        std::size_t m_unnumbered;
+        Timer m_grace;
+        bool m_detached;
         bool m_active;
+        bool m_writing;
+        // Événements diffusés reçus (masque d'"Event").
+        std::uint32_t m_events;
+        // Adresse source, place rendue à la fermeture du socket.
+        Admission::Key m_source;
+        // Numéro de connexion (capture du trafic).
+        std::uint32_t m_connection;
         
       public:
-        Client (Server *, Socket &&);
+        static const std::uint32_t NO_ID = static_cast<std::uint32_t> (-1);
+
+        Client (Server *, std::unique_ptr<Transport>, Admission::Key source = Admission::NONE);
         void start ();
         void stop ();
-        inline std::string alias () const;
+        inline const std::string & alias () const;
+        inline std::uint32_t id () const;
+        inline const std::string & prefix () const;
+        inline const std::string & introduction () const;
+        inline bool introduced () const;
+        inline bool listed () const;
+        void introduce ();
+        void enlist ();
+        inline const std::string & token () const;
+        // Numéro de la dernière trame de la session.
+        inline std::uint64_t sequence () const;
+        inline bool subscribed (Event) const;
+        void subscribe (std::uint32_t events);
         void rename (const std::string &);
+        // Départ : alias et numéro rendus au serveur.
+        void forget ();
+        void write (const std::string &, Lane = CONTROL);
+        // Message au-delà de la taille maximale : envoi par fragments
+        // ("roster" : liste "#users", inscription au dernier fragment).
+        void write (const std::shared_ptr<const std::string> &, bool roster = false);
+        // Reprise de la session d'une connexion interrompue à partir de la
+        // trame "last" ; faux si les trames manquantes ne sont plus conservées.
+        bool adopt (Client & old, std::uint64_t last);
+
+      private:
+        // Session : boucle de lecture et boucle d'écriture.
+        static asio::awaitable<void> session (std::shared_ptr<Client>);
+        asio::awaitable<void> reader (const std::shared_ptr<Client> &);
+        asio::awaitable<void> writer ();
+        asio::mutable_buffer buffer ();
+        void received (const std::shared_ptr<Client> &, std::size_t);
+        void login (const std::shared_ptr<Client> &, const std::string & line);
+        // Émission du jeton de reprise.
+        void open_session ();
+        // Coupure : session conservée pendant le délai de grâce.
+        void detach (const std::shared_ptr<Client> &);
+        void retain (std::string &&);
+        void enqueue (Lane, std::string &&);
+        // Lignes de la voie prises pour l'écriture suivante, jusqu'à "budget"
+        // octets (au moins une).
+        void take (Lane, std::size_t budget, Clock::time_point now);
+        // Trames en attente passées dans la voie prioritaire, dans l'ordre
+        // (avant un changement de numérotation).
+        void promote ();
+        // Numérotation à partir de la trame suivante : trames écrites ou en
+        // attente exclues de la reprise.
+        void renumber (std::uint64_t sequence);
+        // Fragment suivant d'un long message ("#fragment <n> <reste> <texte>") :
+        // en-tête et position du texte dans le message partagé, ou ligne
+        // complète.
+        std::string header (Fragmented &, asio::const_buffer & text) const;
+        std::string fragment (Fragmented &) const;
+    };
+
+    // Nœud voisin du cluster (liaison serveur à serveur).
+    class Peer : public std::enable_shared_from_this<Peer>
+    {
+      private:
+        Server * m_server;
+        Socket m_socket;
+        asio::streambuf m_buffer;
+        std::deque<std::string> m_queue;
+        // Adresse composée ("hôte:port"), vide pour une liaison entrante.
+        std::string m_address;
+        std::string m_node;
+        bool m_active;
+        bool m_redundant;
+
+      public:
+        Peer (Server *, Socket &&, const std::string & address);
+        void start ();
+        void stop ();
+        inline const std::string & node () const;
+        inline const std::string & address () const;
+        inline bool outgoing () const;
+        void identify (const std::string & node);
+        void discard ();
         void read ();
         void write (const std::string &);
+
+      private:
+        void flush ();
     };
 
-    // Pointeur intelligent.
+    // Pointeurs intelligents.
     typedef std::shared_ptr<Client> ClientPtr;
+    typedef std::shared_ptr<Peer> PeerPtr;
     // Signature d'un processeur.
-    typedef void (Server::*Processor) (ClientPtr, const std::string &);
+    typedef void (Server::*Processor) (const ClientPtr &, const std::string &);
+    typedef void (Server::*PeerProcessor) (PeerPtr, const std::string &);
     // Processeurs.
     static const std::map<std::string, Processor> PROCESSORS;
+    static const std::map<std::string, PeerProcessor> PEER_PROCESSORS;
+
+  public:
+    // Options de démarrage.
+    struct Options
+    {
+      // Nom du nœud dans le cluster (par défaut, le port).
+      std::string node;
+      // Port d'écoute des autres nœuds (0 : pas de cluster).
+      unsigned short cluster_port = 0;
+      // Nœuds à contacter ("hôte:port").
+      std::vector<std::string> peers;
+      // Tampons de lecture partagés (enregistrés avec io_uring).
+      std::size_t read_buffers = 1024;
+      std::size_t read_buffer_size = 4096;
+      // Traçage d'un message sur "trace_period" (0 : désactivé), export
+      // dans "trace_file" sur SIGUSR2.
+      std::uint32_t trace_period = 0;
+      std::string trace_file = "trace.json";
+      // Messages privés en attente par alias absent (0 : désactivé),
+      // nombre de boîtes, seuil mémoire de l'ensemble, répertoire de
+      // débordement (vide : aucun) et octets sur disque.
+      std::size_t mailbox_size = 100;
+      std::size_t mailbox_boxes = 10000;
+      std::size_t mailbox_memory = 4 << 20;
+      std::string mailbox_dir = "mailbox";
+      std::size_t mailbox_disk = 64 << 20;
+      // Fenêtre de regroupement des connexions / déconnexions en une trame
+      // "#presence" (0 : "#connected" / "#disconnected" immédiats).
+      unsigned presence_window_ms = 50;
+      // Reprise de session : trames conservées par client (0 : pas de
+      // reprise) et délai de grâce après une coupure.
+      std::size_t resume_buffer = 64;
+      unsigned resume_grace_ms = 30000;
+      // Graine des jetons de session (0 : source non prédictible). Une
+      // graine fixe rend les jetons reproductibles (simulation seulement).
+      std::uint64_t session_seed = 0;
+      // Socket Unix, en plus du port TCP, pour les clients de la même
+      // machine (vide : TCP seulement).
+      std::string unix_path;
+      // Messages publics conservés et indexés pour "/search" (0 : pas de
+      // recherche) ; résultats par requête.
+      std::size_t history = 100000;
+      std::size_t search_results = 20;
+      // Port TLS, en plus du port en clair (0 : pas de TLS), certificat et
+      // clé (PEM), fils dédiés au chiffrement.
+      unsigned short tls_port = 0;
+      std::string tls_certificate;
+      std::string tls_key;
+      std::size_t tls_threads = 1;
+      // Taille maximale d'une ligne envoyée d'un bloc ; au-delà, envoi par
+      // fragments entrelacés avec les autres trames (0 : pas de fragments).
+      std::size_t max_inline = 64 << 10;
+      // Journal : fichier (vide : sortie d'erreur) et niveau minimal.
+      std::string log_file;
+      Log::Level log_level = Log::INFO;
+      // Période du bilan des attentes par voie dans le journal (0 : aucun).
+      unsigned metrics_interval_ms = 60000;
+      // Admission : clients au total (sessions conservées comprises),
+      // connexions par adresse source, connexions par seconde et par
+      // adresse et rafale tolérée (0 : pas de limite).
+      std::size_t max_connections = 0;
+      std::uint32_t max_per_address = 0;
+      double connect_rate = 0.0;
+      double connect_burst = 20.0;
+      // Capture du trafic entrant (vide : pas de capture), pour replay.
+      std::string capture_file;
+      // Placement (listes de CPU "0-3,8", vide : CPU autorisés) : thread
+      // d'e/s, fils TLS (un CPU chacun, à tour de rôle) et threads annexes
+      // (journal, index de recherche).
+      std::string io_cpus;
+      std::string tls_cpus;
+      std::string aux_cpus;
+      // Fragments d'au moins "zerocopy" octets envoyés sans copie vers le
+      // noyau (TCP, Linux ; 0 : jamais).
+      std::size_t zerocopy = 0;
+      // Attente active du thread d'e/s : microsecondes sans événement avant
+      // de bloquer (0 : blocage immédiat) ; SO_BUSY_POLL des sockets
+      // clients (microsecondes, 0 : réglage du système).
+      unsigned busy_poll_us = 0;
+      unsigned socket_busy_poll_us = 0;
+    };
 
   private:
+    // Journal, ouvert avant tout le reste.
+    Log::Sink m_log;
+    // Thread d'e/s fixé avant toute allocation : tampons de lecture et
+    // clients sur le nœud NUMA de ses CPU.
+    Affinity::Cpus m_io_cpus;
+#if defined(CHAT_TLS)
+    // Détruit en dernier : les flux TLS vivent sur ses contextes.
+    std::unique_ptr<TlsPool> m_tls;
+#endif
     asio::io_context m_context;
     asio::ip::tcp::acceptor m_acceptor;
+    asio::ip::tcp::acceptor m_tls_acceptor;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    asio::local::stream_protocol::acceptor m_local_acceptor;
+#endif
+    std::string m_local_path;
+    ReadBuffers m_buffers;
     std::list<ClientPtr> m_clients;
+    // Admission des connexions (poignées de main TLS en cours comptées
+    // dans la limite globale), connexions admises et refusées (par motif)
+    // depuis le dernier bilan.
+    std::size_t m_max_connections;
+    std::size_t m_handshakes;
+    Admission m_admission;
+    std::uint64_t m_admitted;
+    std::uint64_t m_refused [3];
+    // Capture du trafic entrant ; connexions ouvertes depuis le démarrage.
+    Capture m_capture;
+    std::uint32_t m_connections;
+    // Alias des clients : numéro compact, client par numéro, numéros libres.
+    std::unordered_map<std::string, std::uint32_t> m_ids;
+    std::vector<Client *> m_users;
+    std::vector<std::uint32_t> m_free_ids;
+    // Liste des alias publiée (lignes "#users" / "#list" partagées), à
+    // refaire après un changement.
+    Roster m_roster;
+    bool m_roster_stale;
+    // Longue liste "#users" : un seul exemplaire partagé par les fragments
+    // envoyés aux nouveaux venus.
+    std::shared_ptr<const std::string> m_users_payload;
+    // Tampons de trames écrites puis oubliées, réutilisés.
+    std::vector<std::string> m_frames;
+    // Cluster (maillage complet : chaque paire de nœuds reliée).
+    std::string m_node;
+    asio::ip::tcp::acceptor m_cluster_acceptor;
+    std::vector<std::string> m_seeds;
+    std::list<PeerPtr> m_peers;
+    // Alias distants et nœud qui les héberge.
+    std::map<std::string, PeerPtr> m_remote;
+    // Messages privés pour les alias absents, alias en cours de remise.
+    Mailbox m_mailbox;
+    std::unordered_set<std::string> m_delivering;
+    // Historique des messages publics (index sur un fil dédié).
+    Search m_search;
+    std::size_t m_search_results;
+    // Taille maximale d'une ligne envoyée d'un bloc ; taille minimale d'un
+    // fragment envoyé sans copie (0 : jamais).
+    std::size_t m_max_inline;
+    std::size_t m_zerocopy;
+    // Attente avant écriture par voie (microsecondes), bilan périodique.
+    Histogram m_delays [LANES];
+    std::chrono::milliseconds m_metrics_interval;
+    Timer m_metrics_timer;
+    // Attente active (durée avant blocage, blocages depuis le dernier
+    // bilan) ; scrutation des sockets, refus déjà signalé.
+    std::chrono::microseconds m_busy_poll;
+    std::uint64_t m_parks;
+    unsigned m_socket_busy_poll;
+    bool m_busy_poll_refused;
+    // Présence : événements de la fenêtre en cours ("vrai" : connexion) et
+    // clients connectés pendant la fenêtre (liste complète à la fin).
+    std::chrono::milliseconds m_presence_window;
+    Timer m_presence_timer;
+    std::vector<std::pair<std::string, bool>> m_presence;
+    std::vector<ClientPtr> m_newcomers;
+    bool m_presence_scheduled;
+    // Reprise de session.
+    std::size_t m_resume_buffer;
+    std::chrono::milliseconds m_resume_grace;
+    std::uint64_t m_session_seed;
+    std::mt19937_64 m_session_random;
+    // Export de la trace à la demande.
+    asio::signal_set m_signals;
+    std::string m_trace_file;
+    // Arrêt (Ctrl-C, SIGTERM) pendant une capture.
+    asio::signal_set m_stop_signals;
 
   private:
-    // Connexions entrantes.
+    // Boucle du thread d'e/s en attente active.
+    void spin ();
+    // SO_BUSY_POLL sur un socket client.
+    void busy_poll (Socket &);
+    // Connexions entrantes (TCP, socket Unix, TLS).
     void accept ();
+    void accept_local ();
+    void accept_tls ();
+#if defined(CHAT_TLS)
+    asio::awaitable<void> handshake (std::unique_ptr<TlsTransport>, Admission::Key source);
+#endif
+    // Admission d'une connexion (source : Admission::NONE pour un socket
+    // Unix) ; refus : erreur envoyée si possible, socket fermé.
+    template <typename Stream>
+    bool admit (Stream &, Admission::Key source, bool notify = true);
     // Recherche par alias.
     ClientPtr find (const std::string & alias);
+    // Trame "message\n" dans un tampon réutilisé (une seule copie du texte) ;
+    // tampon rendu après usage.
+    std::string frame (const std::string & message);
+    void recycle (std::string &&);
+    // Alias déjà utilisé (localement ou sur un autre nœud) ?
+    bool taken (const std::string & alias);
     // Traitement d'une commande.
-    void process (ClientPtr, const std::string &);
+    void process (const ClientPtr &, const std::string &);
     // Processeurs.
-    void process_message (ClientPtr, const std::string &);
-    // Diffusion d'un message.
-    void broadcast (const std::string & message, ClientPtr emitter = nullptr);
+    void process_message (const ClientPtr &, const std::string &);
+    // Diffusion d'un message aux clients abonnés à "event".
+    void broadcast (const std::string & message, Event event, const ClientPtr & emitter = nullptr);
+    // Message public d'un client local ("#msg <numéro> <texte>"), avec
+    // l'alias pour qui ne le connaît pas encore.
+    void broadcast_message (const ClientPtr & sender, const std::string & text);
     // Suppression d'un client.
-    void remove (ClientPtr);
-    void process_list (ClientPtr, const std::string &);
-    void process_alias (ClientPtr, const std::string &);
-    void process_private (ClientPtr, const std::string &);
-    void process_quit (ClientPtr, const std::string &);
+    void remove (const ClientPtr &);
+    void process_list (const ClientPtr &, const std::string &);
+    void process_alias (const ClientPtr &, const std::string &);
+    void process_private (const ClientPtr &, const std::string &);
+    void process_quit (const ClientPtr &, const std::string &);
+    void process_search (const ClientPtr &, const std::string &);
+    void process_subscribe (const ClientPtr &, const std::string &);
+    // Masque d'événements d'après leurs noms ("messages,presence"...) ;
+    // faux si un nom est inconnu. Noms d'un masque.
+    static bool parse_events (const std::string &, std::uint32_t &);
+    static std::string event_names (std::uint32_t);
+    // Ajout d'un message public à l'historique.
+    void archive (const std::string & sender, const std::string & text);
+    // Connexion ou déconnexion d'un alias (local ou distant).
+    void presence (const std::string & alias, bool joined, const ClientPtr & emitter = nullptr);
+    // Liste initiale d'un client qui vient de se connecter.
+    void welcome (const ClientPtr &);
+    // Liste des alias avec leur numéro ("#users").
+    void roster (const ClientPtr &);
+    // Photographie de la liste des alias, publiée à nouveau si elle a changé
+    // (alias local ou distant, ordre des clients) ; changement signalé.
+    const Roster::Snapshot & snapshot ();
+    void invalidate ();
+    // Envoi des événements de présence regroupés (fin de la fenêtre).
+    void schedule_presence ();
+    void flush_presence ();
+    // Reprise d'une session interrompue ("/resume <jeton> <trame>").
+    void resume (const ClientPtr &, const std::string &);
+    // Remise des messages en attente pour un alias (local ou distant).
+    void deliver (const std::string & alias);
+    // Attente du signal d'export de la trace.
+    void dump_trace ();
+    // Attente d'un signal d'arrêt : capture vidée, puis arrêt habituel.
+    void stop_capture ();
+    // Bilan périodique des attentes par voie.
+    void report_metrics ();
+    // Placement effectif des threads (démarrage).
+    void report_placement ();
+
+  private:
+    // Liaisons entrantes / sortantes avec les autres nœuds.
+    void accept_peer ();
+    void dial (const std::string & address, bool delayed);
+    // Envoi d'une ligne à tous les nœuds (une seule fois par nœud), pour
+    // un événement d'un client local uniquement : une ligne reçue d'un nœud
+    // n'est jamais retransmise. Les nœuds doivent donc former un maillage
+    // complet (un nœud ne voit que les alias et messages de ses voisins).
+    void forward (const std::string & line);
+    // Suppression d'un nœud et de ses alias.
+    void remove_peer (PeerPtr);
+    // Traitement d'une ligne reçue d'un nœud.
+    void process_peer (PeerPtr, const std::string &);
+    // Processeurs.
+    void peer_hello (PeerPtr, const std::string &);
+    void peer_roster (PeerPtr, const std::string &);
+    void peer_join (PeerPtr, const std::string &);
+    void peer_leave (PeerPtr, const std::string &);
+    void peer_rename (PeerPtr, const std::string &);
+    void peer_broadcast (PeerPtr, const std::string &);
+    void peer_private (PeerPtr, const std::string &);
+    void peer_bounce (PeerPtr, const std::string &);
+    void peer_delivered (PeerPtr, const std::string &);
 
   public:
-    // Constructeur.
+    // Constructeurs.
     Server (unsigned short port);
+    Server (unsigned short port, const Options &);
+    ~Server ();
     // Démarrage.
     void start ();
 
@@ -72,313 +541,2189 @@ class Server
     static const std::string INVALID_ALIAS;
     static const std::string INVALID_COMMAND;
     static const std::string INVALID_RECIPIENT;
+    static const std::string INVALID_SESSION;
+    static const std::string MAILBOX_FULL;
     static const std::string MISSING_ARGUMENT;
+    static const std::string INVALID_EVENT;
+    static const std::string SERVER_FULL;
+    static const std::string TOO_MANY_CONNECTIONS;
+    static const std::string CONNECTION_RATE;
+
+  private:
+    // Taille maximale minimale (l'en-tête d'un fragment y tient largement).
+    static constexpr std::size_t MIN_INLINE = 1024;
+    static constexpr std::size_t FRAGMENT_HEADER = 64;
+    // Diffusion emportée par une écriture (octets) : borne l'attente de la
+    // voie prioritaire derrière un client lent.
+    static constexpr std::size_t BULK_BATCH = 64 << 10;
+    // Tampons de trames conservés (nombre, capacité maximale) : les lignes
+    // courantes, pas les longs messages.
+    static constexpr std::size_t FRAME_POOL = 4096;
+    static constexpr std::size_t FRAME_CAPACITY = 4096;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Client //////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-Server::Client::Client (Server * server, Socket && socket) :
+Server::Client::Client (Server * server, std::unique_ptr<Transport> transport, Admission::Key source) :
   m_server {server},
-  m_socket {std::move (socket)},
-  m_active {false}
+  m_transport {std::move (transport)},
+  m_wakeup {server->m_context, Timer::time_point::max ()},
+  m_done {server->m_context, Timer::time_point::max ()},
+  m_slot {server->m_buffers.acquire ()},
+  m_chunk {},
+  m_pending {},
+  m_queues {},
+  m_queued {},
+  m_enqueued {},
+  m_taken {},
+  m_sending {},
+  m_fragmented {},
+  m_writing_fragment {},
+  m_fragment_id {0},
+  m_traces {},
+  m_alias {},
+  m_id {NO_ID},
+  m_prefix {},
+  m_introduction {},
+  m_introduced {false},
+  m_listed {false},
+  m_listing {false},
+  m_token {},
+  m_sequence {0},
+  m_replay {},
+  m_unnumbered {0},
+  m_grace {server->m_context},
+  m_detached {false},
+  m_active {false},
+  m_writing {false},
+  m_events {ALL_EVENTS},
+  m_source {source},
+  m_connection {++server->m_connections}
 {
-  std::cout << "Nouveau client !" << std::endl;
+  // Réserve épuisée : tampon propre au client.
+  if (m_slot == ReadBuffers::NONE)
+    m_chunk.resize (server->m_buffers.size ());
+
+  Log::info ("Nouveau client");
 }
 
 void Server::Client::start ()
 {
-  if (m_active) return;
+  if (m_active || m_writing) return;
 
-  // Pointeur intelligent pour assurer la survie de l'objet.
-  ClientPtr self = shared_from_this ();
+  m_server->m_capture.record (m_connection, Capture::OPEN);
+  // La coroutine de session est l'unique propriétaire du client : les
+  // opérations asynchrones ne copient plus de pointeur intelligent.
+  asio::co_spawn (m_server->m_context, session (shared_from_this ()), asio::detached);
+}
 
-  // Lecture asynchrone.
-  async_read_until (m_socket, m_buffer, '\n',
-    [this, self] (const std::error_code & ec, std::size_t n) {
-      // Erreur ?
-      if (! ec) {
-        std::istream is {&m_buffer};
-        
-        std::string alias;
-        std::getline(is, alias);
+void Server::Client::stop ()
+{
+  m_active = false;
 
-        if (m_server->find(alias) != nullptr)
-        {
-            write(Server::INVALID_ALIAS);
-        }
-        else
-        {
-            m_active = true;
-            
-            rename(alias);
+  m_transport->close ();
+  m_wakeup.cancel ();
+}
 
-            m_server->process_list(self, std::string());
+const std::string & Server::Client::alias () const
+{
+  return m_alias;
+}
 
-            m_server->broadcast("#connected " + alias, self);
+std::uint32_t Server::Client::id () const
+{
+  return m_id;
+}
 
-            read();
-        }
-      }
-      else
-      {
-        std::cout << "Bonjour, au revoir !" << std::endl;
-        m_server->m_clients.remove (self);
-      }
-    });
+const std::string & Server::Client::prefix () const
+{
+  return m_prefix;
 }
 
-void Server::Client::stop ()
+const std::string & Server::Client::introduction () const
 {
-  m_active = false;
+  return m_introduction;
 }
 
-std::string Server::Client::alias () const
+bool Server::Client::introduced () const
 {
-  return m_alias;
+  return m_introduced;
 }
 
-void Server::Client::rename (const std::string & alias)
+bool Server::Client::listed () const
 {
-  m_alias = alias;
-  write ("#alias " + alias);
+  return m_listed;
 }
 
-void Server::Client::read ()
+void Server::Client::introduce ()
 {
-  //std::cout << "Client::read" << std::endl;
+  m_introduced = true;
+}
 
-  // Pointeur intelligent pour assurer la survie de l'objet.
-  ClientPtr self = shared_from_this ();
+void Server::Client::enlist ()
+{
+  m_listed = true;
+}
 
-  // Lecture asynchrone.
-  async_read_until (m_socket, m_buffer, '\n',
-    [this, self] (const std::error_code & ec, std::size_t n) {
-      // Erreur ?
-      if (! ec) {
-        std::istream is {&m_buffer};
-        std::string message;
-        // Traiter tous les messages disponibles.
-        while (std::getline (is, message))
-          m_server->process (self, message);
-        // Si le client est toujours actif, lire à nouveau.
-        if (m_active) read ();
-      }
-      else
-      {
-        std::cout << "Déconnexion intempestive !" << std::endl;
-        m_server->process_quit(self, std::string {});
-      }
-    });
+const std::string & Server::Client::token () const
+{
+  return m_token;
 }
 
-void Server::Client::write (const std::string & message)
+std::uint64_t Server::Client::sequence () const
 {
-  // Ajout du caractère "fin de ligne".
-  std::string m = message + '\n';
-  // Écriture asynchrone.
-  async_write (m_socket,
-               asio::buffer (m.data (), m.length ()),
-               [this] (const std::error_code & ec, std::size_t n) {
-                 // NE RIEN FAIRE
-               });
+  return m_sequence;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// Server //////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
+bool Server::Client::subscribed (Event event) const
+{
+  return (m_events & event) != 0;
+}
 
-Server::Server (unsigned short port) :
-  m_context {},
-  m_acceptor {m_context, asio::ip::tcp::endpoint {asio::ip::tcp::v4 (), port}},
-  m_clients {}
+void Server::Client::subscribe (std::uint32_t events)
 {
+  m_events = events;
 }
 
-void Server::start ()
+void Server::Client::rename (const std::string & alias)
 {
-  // Acceptation des connexions entrantes.
-  accept ();
+  if (m_id != NO_ID)
+    m_server->m_ids.erase (m_alias);
+  else if (! m_server->m_free_ids.empty ())
+  {
+    m_id = m_server->m_free_ids.back ();
+    m_server->m_free_ids.pop_back ();
+    m_server->m_users [m_id] = this;
+  }
+  else
+  {
+    m_id = static_cast<std::uint32_t> (m_server->m_users.size ());
+    m_server->m_users.push_back (this);
+  }
+  m_server->m_ids [alias] = m_id;
+  m_server->invalidate ();
 
-  // Démarrage du contexte.
-  m_context.run ();
+  m_alias = alias;
+  m_prefix = "#msg " + std::to_string (m_id) + " ";
+  m_introduction = "#msg " + std::to_string (m_id) + ":" + alias + " ";
+  m_introduced = false;
+  write ("#alias " + alias);
 }
 
-Server::ClientPtr Server::find (const std::string & alias)
+void Server::Client::forget ()
+{
+  if (m_id == NO_ID) return;
+  m_server->m_ids.erase (m_alias);
+  m_server->invalidate ();
+  m_server->m_users [m_id] = nullptr;
+  m_server->m_free_ids.push_back (m_id);
+  m_id = NO_ID;
+}
+
+void Server::Client::login (const ClientPtr & self, const std::string & line)
 {
-  for (ClientPtr client : m_clients) 
+  // Reprise d'une session interrompue.
+  if (line.compare (0, 8, "/resume ") == 0)
+  {
+    m_server->resume (self, line.substr (8));
+    return;
+  }
+
+  // "/session <alias> [<événements>]" : connexion avec reprise possible.
+  bool session = line.compare (0, 9, "/session ") == 0;
+  std::string alias = session ? line.substr (9) : line;
+  std::string::size_type space = alias.find (' ');
+  if (session && space != std::string::npos)
   {
-    if (client->alias() == alias)
+    std::uint32_t events;
+    if (! Server::parse_events (alias.substr (space + 1), events))
     {
-      return client;
+      write (Server::INVALID_EVENT);
+      return;
     }
+    m_events = events;
+    alias.erase (space);
+  }
+
+  if (m_server->taken (alias))
+  {
+    write (Server::INVALID_ALIAS);
+    return;
   }
-  return nullptr;
+
+  m_active = true;
+
+  rename (alias);
+  if (session && m_server->m_resume_buffer != 0)
+    open_session ();
+
+  m_server->welcome (self);
+
+  m_server->presence (alias, true, self);
+  m_server->forward ("@join " + alias);
+
+  m_server->deliver (alias);
 }
 
-void Server::accept ()
+void Server::Client::open_session ()
 {
-  m_acceptor.async_accept (
-    [this] (const std::error_code & ec, Socket && socket)
-    {
-      // Erreur ?
-      if (! ec)
-      {
-        m_clients.emplace_back (std::make_shared<Client> (this, std::move (socket)));
-        m_clients.back ()->start ();
-      }
+  // Jeton aléatoire de 128 bits (source non prédictible, sauf graine).
+  std::random_device device;
+  std::ostringstream token;
+  token << std::hex << std::setfill ('0');
+  for (int i = 0; i < 4; ++i)
+    token << std::setw (8) << (m_server->m_session_seed != 0 ? static_cast<std::uint32_t> (m_server->m_session_random ()) : device ());
+  m_token = token.str ();
+  m_server->m_capture.record (m_connection, Capture::SESSION, m_token);
 
-      accept();
-    });
+  // "#session" est la trame 0 (le client compte à partir de la suivante) :
+  // elle n'est pas rejouée non plus.
+  write ("#session " + m_token);
+  renumber (0);
 }
 
-void Server::process (ClientPtr client, const std::string & message)
+void Server::Client::detach (const ClientPtr & self)
 {
-  // Lecture d'une éventuelle commande.
-  std::istringstream iss (message);
-  std::string command;
-  if (iss >> command)
-  {
-    // Commande ?
-    if (command[0] == '/')
-    {
-      // Consommation des caractères blancs.
-      iss >> std::ws;
-      // Reste du message.
-      std::string data {std::istreambuf_iterator<char> {iss}, std::istreambuf_iterator<char> {}};
-
-      // Recherche du processeur correspondant.
-      // - S'il existe, l'appeler ;
-      // - Sinon, "#invalid_command" !
-      auto it = PROCESSORS.find(command);
+  m_detached = true;
+  stop ();
 
-      if (it != PROCESSORS.end())
-      {
-        (this->*(it->second)) (client, data);
-      }
-      else
-      {
-        client->write(Server::INVALID_COMMAND);
-      }
+  m_grace.expires_after (m_server->m_resume_grace);
+  m_grace.async_wait ([this, self] (const std::error_code & ec) {
+    // Pas de reprise à temps : départ définitif.
+    if (! ec && m_detached)
+    {
+      m_detached = false;
+      m_server->remove (self);
     }
-    else
-      process_message (client, message);
-  }
+  });
 }
 
-void Server::process_message (ClientPtr client, const std::string & data)
+void Server::Client::enqueue (Lane lane, std::string && frame)
 {
-  std::string m = "<b>" + client->alias () + "</b> : " + data;
-  broadcast (m);
+  if (m_queues [lane].empty ())
+    m_queued [lane] = Clock::now ();
+  m_queues [lane].push_back (std::move (frame));
+  ++m_enqueued [lane];
 }
 
-void Server::remove (ClientPtr client)
+void Server::Client::take (Lane lane, std::size_t budget, Clock::time_point now)
 {
-  m_clients.remove (client);
+  std::deque<std::string> & queue = m_queues [lane];
+  if (queue.empty ()) return;
 
-  if (! client->alias ().empty ())
-    broadcast ("#disconnected " + client->alias ());
+  // Attente de la plus ancienne ligne (majorant pour un reste de la voie,
+  // daté de la même arrivée).
+  m_server->m_delays [lane].add (std::chrono::duration_cast<std::chrono::microseconds> (now - m_queued [lane]).count ());
+
+  std::size_t bytes = 0;
+  while (! queue.empty () && (bytes == 0 || bytes + queue.front ().size () <= budget))
+  {
+    bytes += queue.front ().size ();
+    m_sending.push_back (std::move (queue.front ()));
+    queue.pop_front ();
+    ++m_taken [lane];
+  }
 }
 
-void Server::process_quit (ClientPtr client, const std::string &)
+void Server::Client::promote ()
 {
-  remove(client);
+  // Messages tracés encore en attente suivis dans la voie prioritaire :
+  // même trame, nouveau rang.
+  std::uint64_t shift = m_enqueued [CONTROL] - m_taken [BULK];
+  for (Traced & traced : m_traces)
+    if (traced.lane == BULK && traced.frame > m_taken [BULK])
+      traced = Traced {traced.trace, CONTROL, traced.frame + shift};
+  for (std::string & frame : m_queues [BULK])
+    enqueue (CONTROL, std::move (frame));
+  m_taken [BULK] += m_queues [BULK].size ();
+  m_queues [BULK].clear ();
+  for (Fragmented & fragmented : m_fragmented)
+  {
+    while (fragmented.offset < fragmented.payload->size ())
+      enqueue (CONTROL, fragment (fragmented) + '\n');
+    if (fragmented.trace != 0)
+      m_traces.push_back (Traced {fragmented.trace, CONTROL, m_enqueued [CONTROL]});
+  }
+  m_fragmented.clear ();
+
+  // Reste de la liste dans la voie prioritaire : écrit avant la diffusion.
+  if (m_listing)
+  {
+    m_listing = false;
+    m_listed = true;
+  }
+}
+
+void Server::Client::renumber (std::uint64_t sequence)
+{
+  promote ();
+  m_sequence = sequence;
+  m_unnumbered = m_sending.size () + m_queues [CONTROL].size ();
 }
 
-void Server::broadcast (const std::string & message, ClientPtr emitter)
+void Server::Client::retain (std::string && frame)
 {
-  for (ClientPtr client : m_clients)
+  // Trame antérieure à la numérotation : le client ne la réclamera pas.
+  if (m_unnumbered != 0)
+  {
+    --m_unnumbered;
+    m_server->recycle (std::move (frame));
+    return;
+  }
+
+  m_replay.push_back (std::move (frame));
+  if (m_replay.size () > m_server->m_resume_buffer)
   {
-    if (client != emitter)
+    m_server->recycle (std::move (m_replay.front ()));
+    m_replay.pop_front ();
+  }
+}
+
+bool Server::Client::adopt (Client & old, std::uint64_t last)
+{
+  // Trames conservées par l'ancienne connexion, dans l'ordre : écrites,
+  // en cours d'écriture, en attente (sauf les premières, antérieures à la
+  // numérotation) ; une trame peut porter plusieurs lignes.
+  std::vector<std::string> lines;
+  std::size_t unnumbered = old.m_unnumbered;
+  auto split = [&lines, &unnumbered] (const std::string & frame) {
+    if (unnumbered != 0)
     {
-      client->write(message);
+      --unnumbered;
+      return;
     }
-  }
+    std::string::size_type begin = 0, eol;
+    while ((eol = frame.find ('\n', begin)) != std::string::npos)
+    {
+      lines.emplace_back (frame, begin, eol - begin);
+      begin = eol + 1;
+    }
+  };
+  for (const std::string & frame : old.m_replay) split (frame);
+  for (const std::string & frame : old.m_sending) split (frame);
+  const Writing & writing = old.m_writing_fragment;
+  if (writing.payload && writing.numbered)
+    lines.push_back (writing.header + std::string (static_cast<const char *> (writing.text.data ()), writing.text.size ()));
+  for (const auto & queue : old.m_queues)
+    for (const std::string & frame : queue) split (frame);
+  for (Fragmented fragmented : old.m_fragmented)
+    while (fragmented.offset < fragmented.payload->size ())
+      lines.push_back (old.fragment (fragmented));
+
+  std::uint64_t first = old.m_sequence + 1 - lines.size ();
+  if (last > old.m_sequence || last + 1 < first)
+    return false;
+
+  // L'ancienne connexion (éventuellement encore ouverte) est abandonnée.
+  std::string token;
+  token.swap (old.m_token);
+  old.m_detached = false;
+  old.m_grace.cancel ();
+  old.stop ();
+
+  // Même alias, même numéro.
+  m_alias = old.m_alias;
+  m_prefix = old.m_prefix;
+  m_introduction = old.m_introduction;
+  m_introduced = old.m_introduced;
+  // Liste en fragments : rejouée avant toute diffusion.
+  m_listed = old.m_listed || old.m_listing;
+  m_id = old.m_id;
+  old.m_id = NO_ID;
+  if (m_id != NO_ID)
+    m_server->m_users [m_id] = this;
+  m_token = token;
+  renumber (last);
+  m_fragment_id = old.m_fragment_id;
+  m_events = old.m_events;
+  m_active = true;
+
+  write ("#resumed " + m_alias);
+  for (std::size_t i = last + 1 - first; i < lines.size (); ++i)
+    write (lines [i]);
+  return true;
 }
 
-void Server::process_list (ClientPtr client, const std::string &)
+asio::mutable_buffer Server::Client::buffer ()
 {
-  std::string aliases;
-  bool first = true;
+  if (m_slot != ReadBuffers::NONE)
+    return m_server->m_buffers.buffer (m_slot);
+  return asio::buffer (m_chunk);
+}
+
+asio::awaitable<void> Server::Client::session (ClientPtr self)
+{
+  Client & client = *self;
+
+  // Boucle d'écriture en parallèle de la boucle de lecture.
+  client.m_writing = true;
+  asio::co_spawn (client.m_server->m_context, client.writer (), asio::detached);
 
-  for (ClientPtr c : m_clients)
+  co_await client.reader (self);
+
+  // Fin de la lecture : le client est arrêté, la boucle d'écriture se
+  // termine ; le client ne doit pas être détruit avant elle.
+  client.stop ();
+  if (client.m_writing)
   {
-    if (!first)
-    {
-      aliases += " ";
-    }
-    aliases += c->alias();
-    first = false;
+    asio::error_code ec;
+    co_await client.m_done.async_wait (asio::redirect_error (asio::use_awaitable, ec));
+  }
+
+  // Session conservée : les trames non écrites seront rejouées.
+  if (client.m_detached)
+  {
+    for (std::string & frame : client.m_sending) client.retain (std::move (frame));
+    for (auto & queue : client.m_queues)
+      for (std::string & frame : queue) client.retain (std::move (frame));
+    for (Fragmented & fragmented : client.m_fragmented)
+      while (fragmented.offset < fragmented.payload->size ())
+        client.retain (client.fragment (fragmented) + '\n');
   }
-  client->write("#list " + aliases);
+  client.m_sending.clear ();
+  for (auto & queue : client.m_queues) queue.clear ();
+  client.m_fragmented.clear ();
 }
 
-void Server::process_alias (ClientPtr client, const std::string & data)
+asio::awaitable<void> Server::Client::reader (const ClientPtr & self)
 {
-  std::istringstream iss (data);
-  std::string new_alias;
-
-  if (iss >> new_alias)
+  for (;;)
   {
-    if (find (new_alias) == nullptr)
-    {
-      std::string old_alias = client->alias();
+    asio::error_code ec;
+    std::size_t n;
 
-      client->rename (new_alias);
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+    // Tampon enregistré : lecture IORING_OP_READ_FIXED.
+    if (m_slot != ReadBuffers::NONE && m_server->m_buffers.registered ())
+      n = co_await m_transport->read (m_server->m_buffers.registered (m_slot), ec);
+    else
+#endif
+      n = co_await m_transport->read (buffer (), ec);
 
-      if (!old_alias.empty())
-      {
-         broadcast("#renamed " + old_alias + " " + new_alias);
-      }
+    // Erreur ?
+    if (! ec)
+      received (self, n);
+    else if (ec == asio::error::operation_aborted)
+      ;
+    else if (! m_active)
+    {
+      Log::info ("Bonjour, au revoir");
+      forget ();
+      m_server->m_clients.remove (self);
+    }
+    else if (! m_token.empty () && m_server->m_resume_grace.count () != 0)
+    {
+      Log::info ("Déconnexion intempestive, session conservée", "alias", m_alias);
+      detach (self);
     }
     else
     {
-      client->write (Server::INVALID_ALIAS);
+      Log::info ("Déconnexion intempestive", "alias", m_alias);
+      m_server->process_quit (self, std::string {});
     }
+
+    // Client déconnecté : le tampon de lecture et la place de son adresse
+    // sont rendus.
+    if (ec || ! m_transport->is_open ())
+      break;
   }
-  else
-  {
-    client->write (Server::MISSING_ARGUMENT);
-  }
+
+  m_server->m_buffers.release (m_slot);
+  m_slot = ReadBuffers::NONE;
+  m_server->m_admission.release (m_source);
+  m_source = Admission::NONE;
+  m_server->m_capture.record (m_connection, Capture::CLOSE);
 }
 
-void Server::process_private (ClientPtr client, const std::string & data)
+void Server::Client::received (const ClientPtr & self, std::size_t n)
 {
-  std::istringstream iss (data);
-  std::string recipient_alias;
+  const char * data = static_cast<const char *> (buffer ().data ());
+  const char * end = data + n;
+  std::uint64_t arrival = Trace::enabled () ? Trace::now () : 0;
 
-  if (iss >> recipient_alias)
+  // Traiter toutes les lignes complètes ; la fin est conservée.
+  while (m_transport->is_open ())
   {
-    ClientPtr recipient = find (recipient_alias);
+    const char * eol = static_cast<const char *> (std::memchr (data, '\n', end - data));
+    if (eol == nullptr) break;
 
-    if (recipient != nullptr)
-    {
-      iss >> std::ws;
-      std::string content;
-      std::getline (iss, content);
+    m_pending.append (data, eol);
+    data = eol + 1;
 
-      if (!content.empty())
-        recipient->write ("#private " + client->alias() + " " + content);
-      else
-         client->write (Server::MISSING_ARGUMENT);
+    std::string message;
+    message.swap (m_pending);
+    m_server->m_capture.record (m_connection, Capture::LINE, message);
+
+    if (m_active)
+    {
+      // Message échantillonné : étapes suivantes rattachées au message.
+      std::uint64_t trace = Trace::sample ();
+      if (trace != 0) Trace::record (trace, Trace::RECEIVE, arrival);
+      Trace::Scope scope {trace};
+      m_server->process (self, message);
     }
     else
-      client->write (Server::INVALID_RECIPIENT);
+      login (self, message);
   }
-  else
-    client->write (Server::MISSING_ARGUMENT);
+
+  m_pending.append (data, end);
 }
 
-const std::map<std::string, Server::Processor> Server::PROCESSORS {
-  {"/quit",  &Server::process_quit},
-  {"/list",  &Server::process_list},
-  {"/alias", &Server::process_alias},
-  {"/private",   &Server::process_private}
+void Server::Client::write (const std::string & message, Lane lane)
+{
+  // Ligne trop longue : fragments ; trame de plusieurs lignes : une ligne
+  // à la fois.
+  if (m_server->m_max_inline != 0 && message.size () > m_server->m_max_inline)
+  {
+    if (message.find ('\n') == std::string::npos)
+      write (std::make_shared<const std::string> (message));
+    else
+    {
+      std::string::size_type begin = 0, eol;
+      while ((eol = message.find ('\n', begin)) != std::string::npos)
+      {
+        write (message.substr (begin, eol - begin), lane);
+        begin = eol + 1;
+      }
+      write (message.substr (begin), lane);
+    }
+    return;
+  }
+
+  if (! m_token.empty ())
+    m_sequence += 1 + std::count (message.begin (), message.end (), '\n');
+
+  if (! m_transport->is_open ())
+  {
+    // Session conservée : trame rejouée à la reprise (après les trames
+    // encore aux mains de la boucle d'écriture).
+    if (m_detached && m_writing)
+      enqueue (lane, m_server->frame (message));
+    else if (m_detached)
+      retain (m_server->frame (message));
+    return;
+  }
+
+  // Ajout du caractère "fin de ligne".
+  enqueue (lane, m_server->frame (message));
+
+  if (std::uint64_t trace = Trace::current ())
+  {
+    Trace::record (trace, Trace::ENQUEUE);
+    m_traces.push_back (Traced {trace, lane, m_enqueued [lane]});
+  }
+
+  // Boucle d'écriture en attente : réveil.
+  if (m_sending.empty ()) m_wakeup.cancel ();
+}
+
+void Server::Client::write (const std::shared_ptr<const std::string> & payload, bool roster)
+{
+  Fragmented fragmented {payload, 0, ++m_fragment_id, roster};
+  if (roster) m_listing = true;
+
+  // Nombre de fragments (trames) connu dès maintenant : numérotation.
+  if (! m_token.empty ())
+    for (Fragmented f = fragmented; f.offset < payload->size (); fragment (f))
+      ++m_sequence;
+
+  if (! m_transport->is_open ())
+  {
+    if (m_detached && m_writing)
+      m_fragmented.push_back (std::move (fragmented));
+    else if (m_detached)
+      while (fragmented.offset < payload->size ())
+        retain (fragment (fragmented) + '\n');
+    return;
+  }
+
+  if (std::uint64_t trace = Trace::current ())
+  {
+    Trace::record (trace, Trace::ENQUEUE);
+    fragmented.trace = trace;
+  }
+
+  m_fragmented.push_back (std::move (fragmented));
+  if (m_sending.empty ()) m_wakeup.cancel ();
+}
+
+std::string Server::Client::fragment (Fragmented & fragmented) const
+{
+  asio::const_buffer text;
+  std::string line = header (fragmented, text);
+  line.append (static_cast<const char *> (text.data ()), text.size ());
+  return line;
+}
+
+std::string Server::Client::header (Fragmented & fragmented, asio::const_buffer & text) const
+{
+  const std::string & payload = *fragmented.payload;
+  std::size_t begin = fragmented.offset;
+  std::size_t end = std::min (payload.size (), begin + m_server->m_max_inline - FRAGMENT_HEADER);
+
+  // Coupure hors d'un caractère UTF-8 (octets de continuation 10xxxxxx) :
+  // chaque fragment reste du texte valide.
+  if (end < payload.size ())
+  {
+    std::size_t cut = end;
+    while (cut > begin && (static_cast<unsigned char> (payload [cut]) & 0xC0) == 0x80)
+      --cut;
+    if (cut > begin) end = cut;
+  }
+  fragmented.offset = end;
+  text = asio::buffer (payload.data () + begin, end - begin);
+
+  return "#fragment " + std::to_string (fragmented.id) + " " + std::to_string (payload.size () - end) + " ";
+}
+
+asio::awaitable<void> Server::Client::writer ()
+{
+  while (m_transport->is_open ())
+  {
+    if (m_queues [CONTROL].empty () && m_queues [BULK].empty () && m_fragmented.empty ())
+    {
+      asio::error_code ec;
+      co_await m_wakeup.async_wait (asio::redirect_error (asio::use_awaitable, ec));
+      continue;
+    }
+
+    // Une seule écriture groupée : toute la voie prioritaire, puis la
+    // diffusion jusqu'à BULK_BATCH octets (au moins une ligne par écriture :
+    // jamais affamée). Une réponse n'attend jamais plus d'une écriture.
+    auto now = Clock::now ();
+    take (CONTROL, SIZE_MAX, now);
+    take (BULK, BULK_BATCH, now);
+
+    // Un seul fragment par écriture, longs messages à tour de rôle : les
+    // autres trames ne passent jamais derrière plus d'un fragment. Texte
+    // écrit depuis le message partagé, sans copie.
+    std::shared_ptr<const std::string> payload;
+    std::string header;
+    asio::const_buffer text;
+    bool listed = false;
+    std::uint64_t traced = 0;
+    if (! m_fragmented.empty ())
+    {
+      Fragmented fragmented = std::move (m_fragmented.front ());
+      m_fragmented.pop_front ();
+      payload = fragmented.payload;
+      header = this->header (fragmented, text);
+      if (fragmented.offset < payload->size ())
+        m_fragmented.push_back (std::move (fragmented));
+      else
+      {
+        listed = fragmented.roster;
+        traced = fragmented.trace;
+      }
+    }
+
+    // Messages tracés dont la trame fait partie de cette écriture (quelle
+    // que soit sa voie), ou dont c'est le dernier fragment.
+    std::vector<std::uint64_t> traces;
+    if (traced != 0)
+      traces.push_back (traced);
+    auto written = std::remove_if (m_traces.begin (), m_traces.end (), [this, &traces] (const Traced & t)
+    {
+      if (t.frame > m_taken [t.lane]) return false;
+      traces.push_back (t.trace);
+      return true;
+    });
+    m_traces.erase (written, m_traces.end ());
+
+    std::vector<asio::const_buffer> buffers;
+    buffers.reserve (m_sending.size () + 3);
+    for (const std::string & m : m_sending)
+      buffers.push_back (asio::buffer (m));
+
+    // Fragment écrit avant "#session" : hors numérotation (les trames
+    // d'avant sont décomptées par "m_unnumbered"). Fragment visible d'une
+    // reprise pendant l'écriture.
+    bool numbered = ! m_token.empty ();
+    if (payload)
+      m_writing_fragment = Writing {payload, header, text, numbered};
+    asio::error_code ec;
+    if (payload)
+    {
+      buffers.push_back (asio::buffer (header));
+      if (m_server->m_zerocopy != 0 && text.size () >= m_server->m_zerocopy)
+      {
+        // Gros fragment : texte envoyé sans copie vers le noyau (le message
+        // partagé vit jusqu'à la notification), le reste d'abord.
+        co_await m_transport->write (buffers, ec);
+        if (! ec)
+        {
+          std::vector<asio::const_buffer> tail {text, asio::buffer ("\n", 1)};
+          co_await m_transport->write (tail, payload, ec);
+        }
+      }
+      else
+      {
+        buffers.push_back (text);
+        buffers.push_back (asio::buffer ("\n", 1));
+        co_await m_transport->write (buffers, ec);
+      }
+    }
+    else
+      co_await m_transport->write (buffers, ec);
+    m_writing_fragment = Writing {};
+
+    // Lignes non écrites : conservées pour une reprise, ou abandonnées à la
+    // fin de la session.
+    if (ec)
+    {
+      if (payload && numbered)
+        m_sending.push_back (header.append (static_cast<const char *> (text.data ()), text.size ()) + '\n');
+      break;
+    }
+
+    for (std::uint64_t trace : traces)
+      Trace::record (trace, Trace::WRITE);
+
+    // Dernier fragment de la liste écrit : forme courte des messages.
+    if (listed)
+    {
+      m_listing = false;
+      m_listed = true;
+    }
+
+    // Trames écrites : conservées pour une éventuelle reprise, sinon
+    // tampons rendus.
+    for (std::string & frame : m_sending)
+      if (! m_token.empty ())
+        retain (std::move (frame));
+      else
+        m_server->recycle (std::move (frame));
+    m_sending.clear ();
+    if (payload && numbered)
+      retain (header.append (static_cast<const char *> (text.data ()), text.size ()) + '\n');
+  }
+
+  m_traces.clear ();
+
+  // Signal de fin pour la session.
+  m_writing = false;
+  m_done.cancel ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Peer ////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+Server::Peer::Peer (Server * server, Socket && socket, const std::string & address) :
+  m_server {server},
+  m_socket {std::move (socket)},
+  m_address {address},
+  m_node {},
+  m_active {false},
+  m_redundant {false}
+{
+}
+
+void Server::Peer::start ()
+{
+  if (m_active) return;
+  m_active = true;
+
+  // Présentation : nom du nœud puis alias hébergés localement.
+  write ("@hello " + m_server->m_node);
+
+  std::string roster {"@roster"};
+  for (const ClientPtr & client : m_server->m_clients)
+    if (! client->alias ().empty ())
+      roster += " " + client->alias ();
+  write (roster);
+
+  read ();
+}
+
+void Server::Peer::stop ()
+{
+  if (! m_active) return;
+  m_active = false;
+
+  asio::error_code ec;
+  m_socket.close (ec);
+
+  // Liaison sortante perdue : nouvelle tentative.
+  if (outgoing () && ! m_redundant)
+    m_server->dial (m_address, true);
+}
+
+const std::string & Server::Peer::node () const
+{
+  return m_node;
+}
+
+const std::string & Server::Peer::address () const
+{
+  return m_address;
+}
+
+bool Server::Peer::outgoing () const
+{
+  return ! m_address.empty ();
+}
+
+void Server::Peer::identify (const std::string & node)
+{
+  m_node = node;
+}
+
+void Server::Peer::discard ()
+{
+  // Liaison superflue : pas de nouvelle tentative à la fermeture.
+  m_redundant = true;
+}
+
+void Server::Peer::read ()
+{
+  // Pointeur intelligent pour assurer la survie de l'objet.
+  PeerPtr self = shared_from_this ();
+
+  async_read_until (m_socket, m_buffer, '\n',
+    [this, self] (const std::error_code & ec, std::size_t) {
+      if (! ec) {
+        // Lignes complètes uniquement : la fin du tampon peut être partielle.
+        std::string data {asio::buffers_begin (m_buffer.data ()), asio::buffers_end (m_buffer.data ())};
+        std::string::size_type begin = 0, eol;
+        while (m_active && (eol = data.find ('\n', begin)) != std::string::npos)
+        {
+          m_server->process_peer (self, data.substr (begin, eol - begin));
+          begin = eol + 1;
+        }
+        m_buffer.consume (begin);
+        if (m_active) read ();
+      }
+      else
+        m_server->remove_peer (self);
+    });
+}
+
+void Server::Peer::write (const std::string & line)
+{
+  if (! m_active) return;
+
+  // File d'attente : une seule écriture en cours à la fois.
+  bool idle = m_queue.empty ();
+  m_queue.push_back (line + '\n');
+  if (idle) flush ();
+}
+
+void Server::Peer::flush ()
+{
+  PeerPtr self = shared_from_this ();
+
+  async_write (m_socket,
+               asio::buffer (m_queue.front ()),
+               [this, self] (const std::error_code & ec, std::size_t) {
+                 if (ec)
+                 {
+                   m_queue.clear ();
+                   return;
+                 }
+                 m_queue.pop_front ();
+                 if (! m_queue.empty ()) flush ();
+               });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Server //////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+Server::Server (unsigned short port) :
+  Server (port, Options {})
+{
+}
+
+Server::Server (unsigned short port, const Options & options) :
+  m_log {options.log_file, options.log_level},
+  m_io_cpus {[&options]
+  {
+    Affinity::Cpus cpus = Affinity::parse (options.io_cpus);
+    Affinity::pin (cpus);
+    return cpus;
+  } ()},
+#if defined(CHAT_TLS)
+  m_tls {},
+#endif
+  m_context {},
+  m_acceptor {m_context, asio::ip::tcp::endpoint {asio::ip::tcp::v4 (), port}},
+  m_tls_acceptor {m_context},
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  m_local_acceptor {m_context},
+#endif
+  m_local_path {options.unix_path},
+  m_buffers {m_context, options.read_buffers, options.read_buffer_size},
+  m_clients {},
+  m_max_connections {options.max_connections},
+  m_handshakes {0},
+  m_admission {options.max_per_address, options.connect_rate, options.connect_burst},
+  m_admitted {0},
+  m_refused {},
+  m_capture {options.capture_file},
+  m_connections {0},
+  m_ids {},
+  m_users {},
+  m_free_ids {},
+  m_roster {},
+  m_roster_stale {true},
+  m_users_payload {},
+  m_frames {},
+  m_node {options.node.empty () ? std::to_string (port) : options.node},
+  m_cluster_acceptor {m_context},
+  m_seeds {options.peers},
+  m_peers {},
+  m_remote {},
+  m_mailbox {m_context.get_executor (), options.mailbox_size, options.mailbox_boxes, options.mailbox_memory, options.mailbox_disk, options.mailbox_dir},
+  m_delivering {},
+  m_search {options.history},
+  m_search_results {options.search_results},
+  m_max_inline {options.max_inline == 0 ? 0 : std::max (options.max_inline, MIN_INLINE)},
+  m_zerocopy {options.zerocopy},
+  m_delays {},
+  m_metrics_interval {options.metrics_interval_ms},
+  m_metrics_timer {m_context},
+  m_busy_poll {options.busy_poll_us},
+  m_parks {0},
+  m_socket_busy_poll {options.socket_busy_poll_us},
+  m_busy_poll_refused {false},
+  m_presence_window {options.presence_window_ms},
+  m_presence_timer {m_context},
+  m_presence {},
+  m_newcomers {},
+  m_presence_scheduled {false},
+  m_resume_buffer {options.resume_buffer},
+  m_resume_grace {options.resume_grace_ms},
+  m_session_seed {options.session_seed},
+  m_session_random {options.session_seed},
+  m_signals {m_context},
+  m_trace_file {options.trace_file},
+  m_stop_signals {m_context}
+{
+  Trace::enable (options.trace_period);
+
+  // Threads annexes, créés avant (journal) ou après (boîtes aux lettres,
+  // index) le placement du thread d'e/s : sans liste, tous les CPU
+  // autorisés.
+  Affinity::Cpus aux = options.aux_cpus.empty () ? Affinity::allowed () : Affinity::parse (options.aux_cpus);
+  Affinity::pin (Log::thread (), aux);
+  Affinity::pin (m_mailbox.thread (), aux);
+  Affinity::pin (m_search.thread (), aux);
+  Affinity::pin (m_capture.thread (), aux);
+
+  if (options.cluster_port != 0)
+  {
+    asio::ip::tcp::endpoint endpoint {asio::ip::tcp::v4 (), options.cluster_port};
+    m_cluster_acceptor.open (endpoint.protocol ());
+    m_cluster_acceptor.set_option (asio::ip::tcp::acceptor::reuse_address (true));
+    m_cluster_acceptor.bind (endpoint);
+    m_cluster_acceptor.listen ();
+  }
+
+  if (! m_local_path.empty ())
+  {
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    // Socket laissé par une exécution précédente (connexion refusée :
+    // personne n'écoute) supprimé ; autre fichier, ou socket d'un serveur
+    // en marche : adresse déjà utilisée.
+    asio::local::stream_protocol::endpoint endpoint {m_local_path};
+    std::error_code ec;
+    std::filesystem::file_status status = std::filesystem::symlink_status (m_local_path, ec);
+    if (std::filesystem::exists (status))
+    {
+      asio::local::stream_protocol::socket probe {m_context};
+      asio::error_code refused;
+      if (std::filesystem::is_socket (status))
+        probe.connect (endpoint, refused);
+      if (! std::filesystem::is_socket (status) || refused != asio::error::connection_refused)
+        throw std::system_error {std::make_error_code (std::errc::address_in_use), m_local_path};
+      std::filesystem::remove (m_local_path, ec);
+    }
+
+    m_local_acceptor.open (endpoint.protocol ());
+    m_local_acceptor.bind (endpoint);
+    m_local_acceptor.listen ();
+#else
+    throw std::runtime_error ("sockets Unix indisponibles");
+#endif
+  }
+
+  if (options.tls_port != 0)
+  {
+#if defined(CHAT_TLS)
+    m_tls = std::make_unique<TlsPool> (options.tls_certificate, options.tls_key, options.tls_threads);
+    // Un CPU par fil, à tour de rôle ; sans liste, tous les CPU autorisés
+    // plutôt que ceux du thread d'e/s (hérités).
+    Affinity::Cpus cpus = Affinity::parse (options.tls_cpus);
+    for (std::size_t i = 0; i < m_tls->threads ().size (); ++i)
+      Affinity::pin (m_tls->threads () [i], cpus.empty () ? Affinity::allowed () : Affinity::Cpus {cpus [i % cpus.size ()]});
+
+    asio::ip::tcp::endpoint endpoint {asio::ip::tcp::v4 (), options.tls_port};
+    m_tls_acceptor.open (endpoint.protocol ());
+    m_tls_acceptor.set_option (asio::ip::tcp::acceptor::reuse_address (true));
+    m_tls_acceptor.bind (endpoint);
+    m_tls_acceptor.listen ();
+#else
+    throw std::runtime_error ("TLS indisponible (compiler avec TLS=1)");
+#endif
+  }
+}
+
+Server::~Server ()
+{
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  if (m_local_acceptor.is_open ())
+  {
+    std::error_code ec;
+    std::filesystem::remove (m_local_path, ec);
+  }
+#endif
+}
+
+void Server::start ()
+{
+  Log::info ("Démarrage", "e/s", io_backend ());
+  report_placement ();
+
+  // Acceptation des connexions entrantes.
+  accept ();
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  if (m_local_acceptor.is_open ())
+    accept_local ();
+#endif
+  if (m_tls_acceptor.is_open ())
+    accept_tls ();
+
+  // Cluster : liaisons avec les autres nœuds.
+  if (m_cluster_acceptor.is_open ())
+    accept_peer ();
+  for (const std::string & address : m_seeds)
+    dial (address, false);
+
+  if (m_metrics_interval.count () != 0)
+    report_metrics ();
+
+#if defined(SIGUSR2)
+  // Traçage : export sur "kill -USR2".
+  if (Trace::enabled ())
+  {
+    m_signals.add (SIGUSR2);
+    dump_trace ();
+  }
+#endif
+
+  if (m_capture.enabled ())
+  {
+    m_stop_signals.add (SIGINT);
+    m_stop_signals.add (SIGTERM);
+    stop_capture ();
+  }
+
+  // Démarrage du contexte.
+  if (m_busy_poll.count () != 0)
+    spin ();
+  else
+    m_context.run ();
+}
+
+void Server::spin ()
+{
+  // Passes non bloquantes (poll) tant que des gestionnaires s'exécutent, et
+  // jusqu'à "m_busy_poll" sans rien à faire ; au-delà, blocage jusqu'au
+  // prochain gestionnaire (run_one), puis de nouveau attente active. Un
+  // message arrivé pendant l'attente active est traité sans réveil du
+  // thread ; en contrepartie le thread occupe un cœur (voir --io-cpus).
+  typedef std::chrono::steady_clock Steady;
+  Steady::time_point active = Steady::now ();
+  while (! m_context.stopped ())
+  {
+    if (m_context.poll () != 0)
+      active = Steady::now ();
+    else if (Steady::now () - active >= m_busy_poll)
+    {
+      ++m_parks;
+      if (m_context.run_one () == 0) break;
+      active = Steady::now ();
+    }
+  }
+}
+
+void Server::busy_poll (Socket & socket)
+{
+#if defined(SO_BUSY_POLL)
+  // Lecture sur file vide : un passage de scrutation de la file de réception
+  // de la carte réseau avant de rendre la main. Au-delà du réglage
+  // net.core.busy_read, CAP_NET_ADMIN est requis : refus signalé une fois.
+  int usec = static_cast<int> (m_socket_busy_poll);
+  if (::setsockopt (socket.native_handle (), SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof (usec)) != 0 && ! m_busy_poll_refused)
+  {
+    m_busy_poll_refused = true;
+    Log::warning ("SO_BUSY_POLL refusé", "erreur", std::strerror (errno));
+  }
+#else
+  (void) socket;
+#endif
+}
+
+Server::ClientPtr Server::find (const std::string & alias)
+{
+  auto it = m_ids.find (alias);
+  if (it == m_ids.end ()) return nullptr;
+  return m_users [it->second]->shared_from_this ();
+}
+
+std::string Server::frame (const std::string & message)
+{
+  std::string frame;
+  if (! m_frames.empty ())
+  {
+    frame.swap (m_frames.back ());
+    m_frames.pop_back ();
+  }
+  frame.reserve (message.size () + 1);
+  frame.assign (message);
+  frame += '\n';
+  return frame;
+}
+
+void Server::recycle (std::string && frame)
+{
+  if (m_frames.size () >= FRAME_POOL || frame.capacity () > FRAME_CAPACITY) return;
+  frame.clear ();
+  m_frames.push_back (std::move (frame));
+}
+
+bool Server::taken (const std::string & alias)
+{
+  return find (alias) != nullptr || m_remote.count (alias) != 0;
+}
+
+void Server::accept ()
+{
+  m_acceptor.async_accept (
+    [this] (const std::error_code & ec, Socket && socket)
+    {
+      // Erreur ?
+      if (! ec)
+      {
+        asio::error_code ignored;
+        Admission::Key source = Admission::key (socket.remote_endpoint (ignored).address ());
+        if (admit (socket, source))
+        {
+          if (m_socket_busy_poll != 0)
+            busy_poll (socket);
+          m_clients.emplace_back (std::make_shared<Client> (this, std::make_unique<SocketTransport> (std::move (socket)), source));
+          m_clients.back ()->start ();
+        }
+      }
+
+      accept();
+    });
+}
+
+void Server::accept_local ()
+{
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  // Même protocole et mêmes sessions que les clients TCP.
+  m_local_acceptor.async_accept (
+    [this] (const std::error_code & ec, asio::local::stream_protocol::socket && socket)
+    {
+      if (! ec && admit (socket, Admission::NONE))
+      {
+        m_clients.emplace_back (std::make_shared<Client> (this, std::make_unique<LocalTransport> (std::move (socket))));
+        m_clients.back ()->start ();
+      }
+
+      accept_local ();
+    });
+#endif
+}
+
+void Server::accept_tls ()
+{
+#if defined(CHAT_TLS)
+  // Socket sur un fil de TlsPool ; poignée de main attendue sans bloquer le
+  // fil principal, puis session ordinaire.
+  m_tls_acceptor.async_accept (m_tls->next (),
+    [this] (const std::error_code & ec, Socket && socket)
+    {
+      // Refus sans erreur : le client attend une poignée de main TLS.
+      asio::error_code ignored;
+      Admission::Key source = ec ? Admission::NONE : Admission::key (socket.remote_endpoint (ignored).address ());
+      if (! ec && admit (socket, source, false))
+      {
+        // Place réservée jusqu'à la fin de la poignée de main.
+        ++m_handshakes;
+        if (m_socket_busy_poll != 0)
+          busy_poll (socket);
+        asio::co_spawn (m_context, handshake (std::make_unique<TlsTransport> (std::move (socket), m_tls->ssl ()), source), asio::detached);
+      }
+
+      accept_tls ();
+    });
+#endif
+}
+
+#if defined(CHAT_TLS)
+asio::awaitable<void> Server::handshake (std::unique_ptr<TlsTransport> transport, Admission::Key source)
+{
+  asio::error_code ec;
+  co_await transport->handshake (ec);
+  --m_handshakes;
+  if (ec)
+  {
+    m_admission.release (source);
+    co_return;
+  }
+
+  m_clients.emplace_back (std::make_shared<Client> (this, std::move (transport), source));
+  m_clients.back ()->start ();
+}
+#endif
+
+template <typename Stream>
+bool Server::admit (Stream & socket, Admission::Key source, bool notify)
+{
+  static const char * const REASONS [3] = {"clients", "adresse", "débit"};
+  static const std::string * const ERRORS [3] = {&SERVER_FULL, &TOO_MANY_CONNECTIONS, &CONNECTION_RATE};
+
+  // Limite globale d'abord : un serveur plein ne compte pas la tentative.
+  int reason;
+  if (m_max_connections != 0 && m_clients.size () + m_handshakes >= m_max_connections)
+    reason = 0;
+  else
+  {
+    Admission::Verdict verdict = m_admission.admit (source, Clock::now ().time_since_epoch ());
+    if (verdict == Admission::ADMITTED)
+    {
+      ++m_admitted;
+      return true;
+    }
+    reason = verdict == Admission::TOO_MANY ? 1 : 2;
+  }
+
+  ++m_refused [reason];
+  Log::warning ("Connexion refusée", "motif", REASONS [reason]);
+
+  // Socket neuf : l'erreur tient dans le tampon d'envoi, écriture sans
+  // attente (perdue sinon), puis fermeture.
+  asio::error_code ignored;
+  if (notify)
+  {
+    std::string line = *ERRORS [reason] + '\n';
+    socket.non_blocking (true, ignored);
+    socket.write_some (asio::buffer (line), ignored);
+  }
+  socket.close (ignored);
+  return false;
+}
+
+void Server::process (const ClientPtr & client, const std::string & message)
+{
+  // Lecture d'une éventuelle commande.
+  std::istringstream iss (message);
+  std::string command;
+  if (iss >> command)
+  {
+    // Commande ?
+    if (command[0] == '/')
+    {
+      // Consommation des caractères blancs.
+      iss >> std::ws;
+      // Reste du message.
+      std::string data {std::istreambuf_iterator<char> {iss}, std::istreambuf_iterator<char> {}};
+      Trace::mark (Trace::PARSE);
+
+      // Recherche du processeur correspondant.
+      // - S'il existe, l'appeler ;
+      // - Sinon, "#invalid_command" !
+      auto it = PROCESSORS.find(command);
+
+      if (it != PROCESSORS.end())
+      {
+        Trace::mark (Trace::DISPATCH);
+        (this->*(it->second)) (client, data);
+      }
+      else
+      {
+        client->write(Server::INVALID_COMMAND);
+      }
+    }
+    else
+    {
+      Trace::mark (Trace::PARSE);
+      Trace::mark (Trace::DISPATCH);
+      process_message (client, message);
+    }
+  }
+}
+
+void Server::process_message (const ClientPtr & client, const std::string & data)
+{
+  broadcast_message (client, data);
+  forward ("@broadcast " + client->alias () + " " + data);
+  archive (client->alias (), data);
+}
+
+void Server::archive (const std::string & sender, const std::string & text)
+{
+  if (! m_search.enabled ()) return;
+  std::int64_t time = std::chrono::duration_cast<std::chrono::seconds> (std::chrono::system_clock::now ().time_since_epoch ()).count ();
+  m_search.add (time, sender, text);
+}
+
+void Server::process_search (const ClientPtr & client, const std::string & data)
+{
+  if (! m_search.enabled ())
+  {
+    client->write (Server::INVALID_COMMAND);
+    return;
+  }
+  if (Index::tokens (data).empty ())
+  {
+    client->write (Server::MISSING_ARGUMENT);
+    return;
+  }
+
+  // Requête sur le fil de l'index, résultats rendus au fil principal :
+  // "#found <date> <alias> <message>" par résultat, puis "#search <nombre>".
+  std::weak_ptr<Client> weak = client;
+  m_search.query (data, m_search_results, [this, weak] (std::vector<Index::Hit> hits)
+  {
+    asio::post (m_context, [weak, hits = std::move (hits)]
+    {
+      ClientPtr client = weak.lock ();
+      if (client == nullptr) return;
+      for (const Index::Hit & hit : hits)
+        client->write ("#found " + std::to_string (hit.time) + " " + hit.sender + " " + hit.text);
+      client->write ("#search " + std::to_string (hits.size ()));
+    });
+  });
+}
+
+void Server::process_subscribe (const ClientPtr & client, const std::string & data)
+{
+  // "/subscribe <événement>..." : remplace le masque ; "#subscribed" confirme.
+  std::uint32_t events;
+  if (data.find_first_not_of (" ,") == std::string::npos)
+    client->write (Server::MISSING_ARGUMENT);
+  else if (! parse_events (data, events))
+    client->write (Server::INVALID_EVENT);
+  else
+  {
+    // Messages de nouveau reçus : numéros présentés entre-temps manqués,
+    // liste complète.
+    bool messages = ! client->subscribed (MESSAGES) && (events & MESSAGES) != 0;
+    client->subscribe (events);
+    client->write ("#subscribed " + event_names (events));
+    if (messages)
+      roster (client);
+  }
+}
+
+bool Server::parse_events (const std::string & names, std::uint32_t & events)
+{
+  static const std::map<std::string, std::uint32_t> EVENTS {
+    {"messages", MESSAGES},
+    {"presence", PRESENCE},
+    {"renames",  RENAMES},
+    {"all",      ALL_EVENTS},
+    {"none",     0}
+  };
+
+  // Noms séparés par des virgules ou des espaces.
+  events = 0;
+  std::string::size_type begin = 0;
+  while ((begin = names.find_first_not_of (" ,", begin)) != std::string::npos)
+  {
+    std::string::size_type end = names.find_first_of (" ,", begin);
+    auto it = EVENTS.find (names.substr (begin, end - begin));
+    if (it == EVENTS.end ()) return false;
+    events |= it->second;
+    begin = end;
+  }
+  return true;
+}
+
+std::string Server::event_names (std::uint32_t events)
+{
+  std::string names;
+  if (events & MESSAGES) names += ",messages";
+  if (events & PRESENCE) names += ",presence";
+  if (events & RENAMES)  names += ",renames";
+  return names.empty () ? "none" : names.substr (1);
+}
+
+void Server::remove (const ClientPtr & client)
+{
+  auto it = std::find (m_clients.begin (), m_clients.end (), client);
+  if (it == m_clients.end ()) return;
+  client->stop ();
+  client->forget ();
+
+  if (! client->alias ().empty ())
+  {
+    presence (client->alias (), false);
+    forward ("@leave " + client->alias ());
+  }
+
+  // En dernier : "client" peut désigner l'élément de la liste.
+  m_clients.erase (it);
+}
+
+void Server::process_quit (const ClientPtr & client, const std::string &)
+{
+  remove(client);
+}
+
+void Server::stop_capture ()
+{
+  m_stop_signals.async_wait (
+    [this] (const std::error_code & ec, int number)
+    {
+      if (ec) return;
+
+      m_capture.sync ();
+
+      // Comportement par défaut du signal (fin du processus).
+      m_stop_signals.clear ();
+      std::signal (number, SIG_DFL);
+      std::raise (number);
+    });
+}
+
+void Server::dump_trace ()
+{
+  m_signals.async_wait (
+    [this] (const std::error_code & ec, int)
+    {
+      if (ec) return;
+
+      std::ofstream file {m_trace_file};
+      Trace::dump (file);
+      Log::info ("Trace exportée", "fichier", m_trace_file);
+
+      dump_trace ();
+    });
+}
+
+void Server::report_placement ()
+{
+  Affinity::Cpus cpus = Affinity::allowed ();
+  Log::info ("Topologie", "cpus", Affinity::format (cpus), "nœuds", Affinity::format (Affinity::nodes (cpus)));
+
+  auto report = [] (const std::string & thread, const Affinity::Cpus & cpus)
+  {
+    Log::info ("Placement", "thread", thread, "cpus", Affinity::format (cpus),
+               "nœuds", Affinity::format (Affinity::nodes (cpus)));
+  };
+  report ("e/s", Affinity::current ());
+#if defined(CHAT_TLS)
+  if (m_tls)
+    for (std::size_t i = 0; i < m_tls->threads ().size (); ++i)
+      report ("tls-" + std::to_string (i), Affinity::current (m_tls->threads () [i]));
+#endif
+  report ("journal", Affinity::current (Log::thread ()));
+  if (m_mailbox.thread ().joinable ())
+    report ("boîtes", Affinity::current (m_mailbox.thread ()));
+  if (m_search.enabled ())
+    report ("recherche", Affinity::current (m_search.thread ()));
+  if (m_capture.enabled ())
+    report ("capture", Affinity::current (m_capture.thread ()));
+
+  // Vérification : nœud des pages des tampons de lecture (touchées à la
+  // construction, par le thread d'e/s ; -1 sans tampon ou sans NUMA).
+  Log::info ("Placement mémoire", "tampons_nœud", Affinity::page_node (m_buffers.buffer (0).data ()));
+}
+
+void Server::report_metrics ()
+{
+  m_metrics_timer.expires_after (m_metrics_interval);
+  m_metrics_timer.async_wait ([this] (const std::error_code & ec)
+  {
+    if (ec) return;
+
+    static const char * const NAMES [LANES] = {"control", "bulk"};
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+      Histogram & delays = m_delays [lane];
+      if (delays.count () == 0) continue;
+      Log::info ("Attente avant écriture", "voie", NAMES [lane], "écritures", delays.count (),
+                 "p50_us", delays.percentile (0.50), "p99_us", delays.percentile (0.99),
+                 "p999_us", delays.percentile (0.999));
+      delays.clear ();
+    }
+
+    if (m_busy_poll.count () != 0)
+    {
+      Log::info ("Attente active", "blocages", m_parks);
+      m_parks = 0;
+    }
+
+    if (ZeroCopy::s_sends != 0)
+    {
+      Log::info ("Envois sans copie", "envois", ZeroCopy::s_sends, "terminés", ZeroCopy::s_completions,
+                 "copiés", ZeroCopy::s_copied);
+      ZeroCopy::s_sends = ZeroCopy::s_completions = ZeroCopy::s_copied = 0;
+    }
+
+    std::uint64_t refused = m_refused [0] + m_refused [1] + m_refused [2];
+    if (m_admitted != 0 || refused != 0)
+    {
+      Log::info ("Admission", "clients", m_clients.size (), "adresses", m_admission.size (),
+                 "admises", m_admitted, "refusées_clients", m_refused [0],
+                 "refusées_adresse", m_refused [1], "refusées_débit", m_refused [2]);
+      m_admitted = 0;
+      std::fill (std::begin (m_refused), std::end (m_refused), 0);
+    }
+
+    report_metrics ();
+  });
+}
+
+void Server::broadcast (const std::string & message, Event event, const ClientPtr & emitter)
+{
+  // Long message : un seul exemplaire, partagé par les files des clients.
+  if (m_max_inline != 0 && message.size () > m_max_inline && message.find ('\n') == std::string::npos)
+  {
+    auto payload = std::make_shared<const std::string> (message);
+    for (const ClientPtr & client : m_clients)
+      if (client != emitter && client->subscribed (event))
+        client->write (payload);
+    return;
+  }
+
+  for (const ClientPtr & client : m_clients)
+  {
+    if (client != emitter && client->subscribed (event))
+    {
+      client->write(message, BULK);
+    }
+  }
+}
+
+void Server::broadcast_message (const ClientPtr & sender, const std::string & text)
+{
+  // Début de ligne rendu au changement d'alias : une seule copie du texte
+  // par forme. Forme longue ("<numéro>:<alias>") au premier message après
+  // un changement d'alias, et pour les clients qui attendent encore la
+  // liste des numéros.
+  const std::string * prefixes [] = {&sender->prefix (), &sender->introduction ()};
+  std::string lines [2];
+  std::shared_ptr<const std::string> payloads [2];
+  bool introduce = ! sender->introduced ();
+
+  for (const ClientPtr & client : m_clients)
+  {
+    if (! client->subscribed (MESSAGES)) continue;
+
+    int form = introduce || ! client->listed () ? 1 : 0;
+    std::string & line = lines [form];
+    if (line.empty ())
+    {
+      line.reserve (prefixes [form]->size () + text.size ());
+      line += *prefixes [form];
+      line += text;
+    }
+
+    // Long message : un seul exemplaire par forme, partagé.
+    if (m_max_inline != 0 && line.size () > m_max_inline)
+    {
+      if (! payloads [form])
+        payloads [form] = std::make_shared<const std::string> (line);
+      client->write (payloads [form]);
+    }
+    else
+      client->write (line, BULK);
+  }
+
+  sender->introduce ();
+}
+
+void Server::welcome (const ClientPtr & client)
+{
+  // Fenêtre de présence ouverte : la liste partira avec la trame de
+  // présence, et tiendra compte des événements de la fenêtre.
+  if (m_presence_window.count () != 0)
+  {
+    m_newcomers.push_back (client);
+    schedule_presence ();
+  }
+  else
+    roster (client);
+}
+
+void Server::roster (const ClientPtr & client)
+{
+  const std::string & users = snapshot ().users;
+  if (m_max_inline != 0 && users.size () > m_max_inline)
+  {
+    if (! m_users_payload)
+      m_users_payload = std::make_shared<const std::string> (users);
+    client->write (m_users_payload, true);
+  }
+  else
+  {
+    // Voie prioritaire : écrite avant toute ligne "#msg" en attente.
+    client->write (users);
+    client->enlist ();
+  }
+}
+
+const Roster::Snapshot & Server::snapshot ()
+{
+  if (! m_roster_stale) return m_roster.current ();
+  m_roster_stale = false;
+  m_users_payload.reset ();
+
+  // Alias locaux avec leur numéro, alias des autres nœuds sans (":alias").
+  Roster::Snapshot snapshot;
+  std::string & users = snapshot.users;
+  std::string & list = snapshot.list;
+  users = "#users";
+  list = "#list";
+  for (const ClientPtr & c : m_clients)
+  {
+    if (c->alias ().empty ()) continue;
+    users += ' ';
+    users += std::to_string (c->id ());
+    users += ':';
+    users += c->alias ();
+    list += ' ';
+    list += c->alias ();
+  }
+  for (const auto & remote : m_remote)
+  {
+    users += " :";
+    users += remote.first;
+    list += ' ';
+    list += remote.first;
+  }
+
+  m_roster.publish (std::move (snapshot));
+  return m_roster.current ();
+}
+
+void Server::invalidate ()
+{
+  m_roster_stale = true;
+}
+
+void Server::presence (const std::string & alias, bool joined, const ClientPtr & emitter)
+{
+  if (m_presence_window.count () == 0)
+  {
+    broadcast ((joined ? "#connected " : "#disconnected ") + alias, PRESENCE, emitter);
+    return;
+  }
+
+  m_presence.emplace_back (alias, joined);
+  schedule_presence ();
+}
+
+void Server::schedule_presence ()
+{
+  // Premier événement de la fenêtre : envoi différé.
+  if (m_presence_scheduled) return;
+  m_presence_scheduled = true;
+
+  m_presence_timer.expires_after (m_presence_window);
+  m_presence_timer.async_wait ([this] (const std::error_code & ec) {
+    if (! ec) flush_presence ();
+  });
+}
+
+void Server::flush_presence ()
+{
+  m_presence_scheduled = false;
+  m_presence_timer.cancel ();
+  if (m_presence.empty () && m_newcomers.empty ()) return;
+
+  // Bilan de la fenêtre par alias : seul compte l'écart entre l'état
+  // initial (déduit du premier événement) et l'état final.
+  std::map<std::string, std::pair<bool, bool>> states;
+  std::vector<std::string> order;
+  for (const auto & event : m_presence)
+  {
+    auto it = states.find (event.first);
+    if (it == states.end ())
+    {
+      states.emplace (event.first, std::make_pair (! event.second, event.second));
+      order.push_back (event.first);
+    }
+    else
+      it->second.second = event.second;
+  }
+  m_presence.clear ();
+
+  std::string diff {"#presence"};
+  for (const std::string & alias : order)
+  {
+    const auto & state = states [alias];
+    if (state.first != state.second)
+      diff += (state.second ? " +" : " -") + alias;
+  }
+
+  // Une seule trame par destinataire ; les nouveaux venus reçoivent la
+  // liste complète à la place.
+  std::unordered_set<Client *> newcomers;
+  for (const ClientPtr & client : m_newcomers)
+    newcomers.insert (client.get ());
+
+  if (diff != "#presence")
+    for (const ClientPtr & client : m_clients)
+      if (newcomers.count (client.get ()) == 0 && client->subscribed (PRESENCE))
+        client->write (diff, BULK);
+
+  std::vector<ClientPtr> welcomed;
+  welcomed.swap (m_newcomers);
+  for (const ClientPtr & client : welcomed)
+    roster (client);
+}
+
+void Server::process_list (const ClientPtr & client, const std::string &)
+{
+  // Alias locaux puis alias hébergés par les autres nœuds.
+  client->write (snapshot ().list);
+}
+
+void Server::process_alias (const ClientPtr & client, const std::string & data)
+{
+  std::istringstream iss (data);
+  std::string new_alias;
+
+  if (iss >> new_alias)
+  {
+    if (! taken (new_alias))
+    {
+      std::string old_alias = client->alias();
+
+      client->rename (new_alias);
+
+      if (!old_alias.empty())
+      {
+         // Présence en attente d'abord : l'ancien alias doit être connu.
+         flush_presence ();
+         broadcast("#renamed " + old_alias + " " + new_alias, RENAMES);
+         forward("@rename " + old_alias + " " + new_alias);
+         deliver (new_alias);
+      }
+    }
+    else
+    {
+      client->write (Server::INVALID_ALIAS);
+    }
+  }
+  else
+  {
+    client->write (Server::MISSING_ARGUMENT);
+  }
+}
+
+void Server::process_private (const ClientPtr & client, const std::string & data)
+{
+  std::istringstream iss (data);
+  std::string recipient_alias;
+
+  if (iss >> recipient_alias)
+  {
+    ClientPtr recipient = find (recipient_alias);
+    auto remote = m_remote.find (recipient_alias);
+
+    if (recipient != nullptr || remote != m_remote.end () || m_mailbox.enabled ())
+    {
+      iss >> std::ws;
+      std::string content;
+      std::getline (iss, content);
+
+      if (content.empty())
+         client->write (Server::MISSING_ARGUMENT);
+      else if (recipient != nullptr)
+      {
+        recipient->write ("#private " + client->alias() + " " + content);
+        client->write ("#delivered " + recipient_alias);
+      }
+      else if (remote != m_remote.end ())
+        // Routage vers le nœud qui héberge le destinataire (accusé de
+        // réception par "@delivered").
+        remote->second->write ("@private " + client->alias () + " " + recipient_alias + " " + content);
+      else if (m_mailbox.store (recipient_alias, client->alias (), content))
+        // Destinataire absent : message en attente de sa connexion.
+        client->write ("#queued " + recipient_alias);
+      else
+        client->write (Server::MAILBOX_FULL);
+    }
+    else
+      client->write (Server::INVALID_RECIPIENT);
+  }
+  else
+    client->write (Server::MISSING_ARGUMENT);
+}
+
+void Server::resume (const ClientPtr & client, const std::string & data)
+{
+  std::istringstream iss (data);
+  std::string token;
+  std::uint64_t last;
+  if (! (iss >> token >> last))
+  {
+    client->write (Server::INVALID_SESSION);
+    return;
+  }
+
+  auto it = std::find_if (m_clients.begin (), m_clients.end (),
+                          [&] (const ClientPtr & c) { return c != client && c->token () == token; });
+  if (it == m_clients.end ())
+  {
+    client->write (Server::INVALID_SESSION);
+    return;
+  }
+
+  // La nouvelle connexion reprend l'alias et la place de l'ancienne, sans
+  // annonce de départ ni d'arrivée.
+  ClientPtr old = *it;
+  if (client->adopt (*old, last))
+  {
+    m_clients.erase (std::find (m_clients.begin (), m_clients.end (), old));
+    invalidate ();
+  }
+  else
+  {
+    // Trames manquantes perdues : départ de l'ancienne session, le client
+    // se reconnecte normalement.
+    client->write (Server::INVALID_SESSION);
+    remove (old);
+  }
+}
+
+void Server::deliver (const std::string & alias)
+{
+  if (! m_mailbox.has (alias) || m_delivering.count (alias) != 0) return;
+  if (find (alias) == nullptr && m_remote.count (alias) == 0) return;
+
+  // Messages "expéditeur contenu", du plus ancien au plus récent ; boîte
+  // débordée relue hors du fil du serveur, un seul retrait à la fois par
+  // alias (ordre des messages déposés entre-temps).
+  m_delivering.insert (alias);
+  m_mailbox.take (alias, [this, alias] (std::vector<std::string> messages)
+  {
+    m_delivering.erase (alias);
+
+    // Destinataire reparti pendant la relecture : messages rendus à la
+    // boîte.
+    ClientPtr recipient = find (alias);
+    auto remote = m_remote.find (alias);
+    if (recipient == nullptr && remote == m_remote.end ())
+    {
+      m_mailbox.restore (alias, messages);
+      return;
+    }
+
+    if (recipient != nullptr)
+    {
+      // Une seule écriture pour tout le lot.
+      std::string batch;
+      for (const std::string & message : messages)
+      {
+        if (! batch.empty ()) batch += '\n';
+        batch += "#private " + message;
+      }
+      recipient->write (batch);
+    }
+
+    for (const std::string & message : messages)
+    {
+      std::string::size_type space = message.find (' ');
+      std::string sender = message.substr (0, space);
+
+      if (recipient == nullptr)
+        remote->second->write ("@private " + sender + " " + alias + " " + message.substr (space + 1));
+      else if (ClientPtr client = find (sender))
+        client->write ("#delivered " + alias);
+    }
+
+    // Messages déposés pendant la relecture.
+    deliver (alias);
+  });
+}
+
+void Server::accept_peer ()
+{
+  m_cluster_acceptor.async_accept (
+    [this] (const std::error_code & ec, Socket && socket)
+    {
+      if (! ec)
+      {
+        m_peers.emplace_back (std::make_shared<Peer> (this, std::move (socket), std::string {}));
+        m_peers.back ()->start ();
+      }
+
+      accept_peer ();
+    });
+}
+
+void Server::dial (const std::string & address, bool delayed)
+{
+  std::string::size_type colon = address.rfind (':');
+  if (colon == std::string::npos)
+  {
+    Log::warning ("Nœud invalide", "adresse", address);
+    return;
+  }
+
+  auto timer = std::make_shared<Timer> (m_context);
+  timer->expires_after (std::chrono::seconds (delayed ? 1 : 0));
+  timer->async_wait ([this, timer, address, colon] (const std::error_code &)
+  {
+    auto socket = std::make_shared<Socket> (m_context);
+    asio::ip::tcp::resolver resolver {m_context};
+    asio::error_code ec;
+    auto endpoints = resolver.resolve (address.substr (0, colon), address.substr (colon + 1), ec);
+    if (ec)
+    {
+      dial (address, true);
+      return;
+    }
+
+    asio::async_connect (*socket, endpoints,
+      [this, socket, address] (const std::error_code & ec, const asio::ip::tcp::endpoint &)
+      {
+        if (ec)
+        {
+          dial (address, true);
+          return;
+        }
+
+        m_peers.emplace_back (std::make_shared<Peer> (this, std::move (*socket), address));
+        m_peers.back ()->start ();
+      });
+  });
+}
+
+void Server::forward (const std::string & line)
+{
+  for (PeerPtr peer : m_peers)
+    peer->write (line);
+}
+
+void Server::remove_peer (PeerPtr peer)
+{
+  auto it = std::find (m_peers.begin (), m_peers.end (), peer);
+  if (it == m_peers.end ()) return;
+  m_peers.erase (it);
+
+  // Les alias hébergés par ce nœud disparaissent.
+  for (auto remote = m_remote.begin (); remote != m_remote.end (); )
+  {
+    if (remote->second == peer)
+    {
+      presence (remote->first, false);
+      remote = m_remote.erase (remote);
+      invalidate ();
+    }
+    else
+      ++remote;
+  }
+
+  peer->stop ();
+}
+
+void Server::process_peer (PeerPtr peer, const std::string & line)
+{
+  std::string::size_type space = line.find (' ');
+  std::string command = line.substr (0, space);
+  std::string data = space == std::string::npos ? std::string {} : line.substr (space + 1);
+
+  auto it = PEER_PROCESSORS.find (command);
+  if (it != PEER_PROCESSORS.end ())
+    (this->*(it->second)) (peer, data);
+}
+
+void Server::peer_hello (PeerPtr peer, const std::string & data)
+{
+  peer->identify (data);
+
+  if (data == m_node)
+  {
+    // Liaison avec soi-même.
+    peer->discard ();
+    remove_peer (peer);
+    return;
+  }
+
+  for (PeerPtr other : m_peers)
+  {
+    if (other != peer && other->node () == data)
+    {
+      // Liaison en double : les deux nœuds conservent celle qui a été
+      // initiée par le nœud de plus petit nom.
+      const std::string & a = other->outgoing () ? m_node : data;
+      const std::string & b = peer->outgoing () ? m_node : data;
+      PeerPtr redundant = (b < a) ? other : peer;
+      redundant->discard ();
+      remove_peer (redundant);
+      return;
+    }
+  }
+}
+
+void Server::peer_roster (PeerPtr peer, const std::string & data)
+{
+  std::istringstream iss (data);
+  std::string alias;
+  while (iss >> alias)
+    peer_join (peer, alias);
+}
+
+void Server::peer_join (PeerPtr peer, const std::string & alias)
+{
+  // Le nœud a pu être écarté entre-temps (liaison en double).
+  if (std::find (m_peers.begin (), m_peers.end (), peer) == m_peers.end ())
+    return;
+
+  m_remote [alias] = peer;
+  invalidate ();
+  presence (alias, true);
+
+  deliver (alias);
+}
+
+void Server::peer_leave (PeerPtr peer, const std::string & alias)
+{
+  auto it = m_remote.find (alias);
+  if (it != m_remote.end () && it->second == peer)
+  {
+    m_remote.erase (it);
+    invalidate ();
+    presence (alias, false);
+  }
+}
+
+void Server::peer_rename (PeerPtr peer, const std::string & data)
+{
+  std::istringstream iss (data);
+  std::string old_alias, new_alias;
+  if (iss >> old_alias >> new_alias)
+  {
+    auto it = m_remote.find (old_alias);
+    if (it != m_remote.end () && it->second == peer)
+    {
+      m_remote.erase (it);
+      m_remote [new_alias] = peer;
+      invalidate ();
+      flush_presence ();
+      broadcast ("#renamed " + old_alias + " " + new_alias, RENAMES);
+      deliver (new_alias);
+    }
+  }
+}
+
+void Server::peer_broadcast (PeerPtr, const std::string & data)
+{
+  // "<alias> <texte>" : alias sans numéro local ("#msg :<alias> <texte>").
+  std::string::size_type space = data.find (' ');
+  if (space == std::string::npos) return;
+
+  // Diffusion locale uniquement : chaque nœud reçoit le message une seule fois.
+  broadcast ("#msg :" + data, MESSAGES);
+
+  // Historique de chaque nœud : tous les messages publics du cluster.
+  archive (data.substr (0, space), data.substr (space + 1));
+}
+
+void Server::peer_private (PeerPtr peer, const std::string & data)
+{
+  std::istringstream iss (data);
+  std::string sender, recipient_alias;
+  if (iss >> sender >> recipient_alias)
+  {
+    iss >> std::ws;
+    std::string content;
+    std::getline (iss, content);
+
+    ClientPtr recipient = find (recipient_alias);
+    if (recipient != nullptr)
+    {
+      recipient->write ("#private " + sender + " " + content);
+      peer->write ("@delivered " + sender + " " + recipient_alias);
+    }
+    else
+      peer->write ("@bounce " + sender + " " + recipient_alias + " " + content);
+  }
+}
+
+void Server::peer_bounce (PeerPtr, const std::string & data)
+{
+  // Destinataire parti entre-temps : message mis en attente sur le nœud
+  // de l'émetteur (ou erreur renvoyée à l'émetteur).
+  std::istringstream iss (data);
+  std::string sender, recipient_alias;
+  if (iss >> sender >> recipient_alias)
+  {
+    iss >> std::ws;
+    std::string content;
+    std::getline (iss, content);
+
+    ClientPtr client = find (sender);
+    if (! m_mailbox.enabled ())
+    {
+      if (client != nullptr) client->write (Server::INVALID_RECIPIENT);
+    }
+    else if (m_mailbox.store (recipient_alias, sender, content))
+    {
+      if (client != nullptr) client->write ("#queued " + recipient_alias);
+      // Destinataire revenu entre-temps.
+      deliver (recipient_alias);
+    }
+    else if (client != nullptr)
+      client->write (Server::MAILBOX_FULL);
+  }
+}
+
+void Server::peer_delivered (PeerPtr, const std::string & data)
+{
+  // Accusé de réception d'un message privé routé vers un autre nœud.
+  std::istringstream iss (data);
+  std::string sender, recipient_alias;
+  if (iss >> sender >> recipient_alias)
+  {
+    ClientPtr client = find (sender);
+    if (client != nullptr)
+      client->write ("#delivered " + recipient_alias);
+  }
+}
+
+const std::map<std::string, Server::Processor> Server::PROCESSORS {
+  {"/quit",  &Server::process_quit},
+  {"/list",  &Server::process_list},
+  {"/alias", &Server::process_alias},
+  {"/private",   &Server::process_private},
+  {"/search",    &Server::process_search},
+  {"/subscribe", &Server::process_subscribe}
+};
+
+const std::map<std::string, Server::PeerProcessor> Server::PEER_PROCESSORS {
+  {"@hello",     &Server::peer_hello},
+  {"@roster",    &Server::peer_roster},
+  {"@join",      &Server::peer_join},
+  {"@leave",     &Server::peer_leave},
+  {"@rename",    &Server::peer_rename},
+  {"@broadcast", &Server::peer_broadcast},
+  {"@private",   &Server::peer_private},
+  {"@bounce",    &Server::peer_bounce},
+  {"@delivered", &Server::peer_delivered}
 };
 
 const std::string Server::INVALID_ALIAS     {"#error invalid_alias"};
 const std::string Server::INVALID_COMMAND   {"#error invalid_command"};
 const std::string Server::INVALID_RECIPIENT {"#error invalid_recipient"};
 const std::string Server::MISSING_ARGUMENT  {"#error missing_argument"};
+const std::string Server::INVALID_SESSION   {"#error invalid_session"};
+const std::string Server::MAILBOX_FULL      {"#error mailbox_full"};
+const std::string Server::INVALID_EVENT     {"#error invalid_event"};
+const std::string Server::SERVER_FULL       {"#error server_full"};
+const std::string Server::TOO_MANY_CONNECTIONS {"#error too_many_connections"};
+const std::string Server::CONNECTION_RATE   {"#error connection_rate"};
 
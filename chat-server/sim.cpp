@@ -0,0 +1,661 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <new>
+#include <queue>
+#include <random>
+#include <sys/resource.h>
+#include "server.hpp"
+
+#if ! defined(CHAT_VIRTUAL_CLOCK)
+#error "sim.cpp : compiler avec -DCHAT_VIRTUAL_CLOCK (make sim)"
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocations /////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Compteur d'allocations du processus (opérateurs new remplacés ; pas
+// d'extension en ligne, que GCC prendrait pour un mélange new / free).
+static std::atomic<std::uint64_t> allocations {0};
+
+[[gnu::noinline]] void * operator new (std::size_t size)
+{
+  allocations.fetch_add (1, std::memory_order_relaxed);
+  if (void * pointer = std::malloc (size == 0 ? 1 : size))
+    return pointer;
+  throw std::bad_alloc {};
+}
+
+[[gnu::noinline]] void operator delete (void * pointer) noexcept
+{
+  std::free (pointer);
+}
+
+[[gnu::noinline]] void operator delete (void * pointer, std::size_t) noexcept
+{
+  std::free (pointer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Simulation //////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Simulation déterministe du serveur : des milliers de clients en mémoire
+// (aucun socket), une horloge virtuelle avancée par pas de 1 ms, un scénario
+// tiré d'une graine (connexions, messages publics et privés, changements
+// d'alias, coupures suivies d'une reprise de session, départs). Les octets
+// reçus par les clients sont résumés par une empreinte : même graine, même
+// empreinte. Résultat : une ligne JSON, avec le temps CPU et le nombre
+// d'allocations du scénario, comparables à des seuils.
+class Simulation
+{
+  public:
+    struct Settings
+    {
+      std::uint64_t seed = 1;
+      std::size_t clients = 10000;
+      // Connexions par seconde (montée en charge), durée après la montée.
+      double connect_rate = 5000;
+      double duration = 10;
+      // Événements par seconde, sur l'ensemble des clients.
+      double messages = 20;
+      double privates = 100;
+      double renames = 5;
+      double drops = 20;
+      double quits = 5;
+      // Seuils (0 : aucun).
+      std::uint64_t max_cpu_ms = 0;
+      std::uint64_t max_allocations = 0;
+    };
+
+  private:
+    typedef Server::Timer Timer;
+
+    enum State { OFFLINE, CONNECTING, ONLINE, DROPPED };
+    enum Action { CONNECT, RECONNECT };
+
+    // Connexion en mémoire, vue des deux côtés : entrée du serveur et
+    // analyse au fil de l'eau de ce qu'il écrit.
+    struct Pipe
+    {
+      Simulation * simulation;
+      std::size_t user;
+      Timer signal;
+      std::string input;
+      bool open = true;
+      bool closed = false;
+      // Début de la ligne en cours (commande et premier argument).
+      std::string head;
+
+      Pipe (Simulation *, std::size_t user, asio::any_io_executor);
+    };
+
+    class SimTransport : public Transport
+    {
+      private:
+        std::shared_ptr<Pipe> m_pipe;
+
+      public:
+        explicit SimTransport (std::shared_ptr<Pipe>);
+        bool is_open () const override;
+        void close () override;
+        asio::awaitable<std::size_t> read (asio::mutable_buffer, asio::error_code &) override;
+        asio::awaitable<void> write (const std::vector<asio::const_buffer> &, asio::error_code &) override;
+    };
+
+    struct User
+    {
+      std::string alias;
+      State state = OFFLINE;
+      std::shared_ptr<Pipe> pipe;
+      // Jeton de session et trames reçues depuis "#session" ; trames
+      // manquées à la reprise (aucune session : au-delà de toute limite).
+      std::string token;
+      std::uint64_t frames = 0;
+      std::uint64_t missed = 0;
+      std::size_t renames = 0;
+      // Empreinte (FNV-1a 64 bits) des octets reçus, toutes connexions
+      // confondues : indépendante du découpage des écritures.
+      std::uint64_t digest = 0xcbf29ce484222325ULL;
+      // Position dans "m_online".
+      std::size_t slot = 0;
+    };
+
+    struct Scheduled
+    {
+      std::uint64_t time;
+      std::uint64_t order;
+      Action action;
+      std::size_t user;
+      bool operator> (const Scheduled & other) const
+      {
+        return time != other.time ? time > other.time : order > other.order;
+      }
+    };
+
+    // Début de ligne conservé : assez pour "#session <jeton>".
+    static const std::size_t HEAD = 64;
+
+    Settings m_settings;
+    Server m_server;
+    std::mt19937_64 m_random;
+    std::vector<User> m_users;
+    std::vector<std::size_t> m_online;
+    std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled>> m_agenda;
+    std::uint64_t m_order;
+    std::uint64_t m_now;
+    std::uint64_t m_bytes;
+    std::uint64_t m_frames;
+    // Compteurs du scénario.
+    std::uint64_t m_connects;
+    std::uint64_t m_messages;
+    std::uint64_t m_privates;
+    std::uint64_t m_renames;
+    std::uint64_t m_drops;
+    std::uint64_t m_resumed;
+    std::uint64_t m_expired;
+    // Reprises refusées alors que les trames manquées étaient conservées.
+    std::uint64_t m_refused;
+    std::uint64_t m_quits;
+    std::uint64_t m_errors;
+
+  public:
+    explicit Simulation (const Settings &);
+    // Exécution du scénario ; faux si un seuil est dépassé.
+    bool run (std::ostream &);
+    // Session du premier client coupée juste après "#session" (moins de
+    // trames que "resume_buffer"), puis reprise ; faux si elle est refusée.
+    bool check_resume ();
+
+  private:
+    static Server::Options options (const Settings &);
+    // Avance de l'horloge virtuelle et exécution de ce qui est prêt.
+    void step (std::uint64_t ms);
+    void schedule (std::uint64_t delay, Action, std::size_t user);
+    // Nombre d'événements du pas pour un débit donné (tirage de Poisson).
+    std::size_t draw (double rate);
+    std::size_t pick ();
+    void connect (std::size_t user, bool resume);
+    void send (std::size_t user, const std::string & line);
+    void drop (std::size_t user);
+    void quit (std::size_t user);
+    void online (std::size_t user);
+    void offline (std::size_t user);
+    // Octets écrits par le serveur vers un client.
+    void receive (Pipe &, const char *, std::size_t);
+    void line (Pipe &);
+};
+
+Simulation::Pipe::Pipe (Simulation * s, std::size_t u, asio::any_io_executor executor) :
+  simulation {s},
+  user {u},
+  signal {executor, Timer::time_point::max ()}
+{
+}
+
+Simulation::SimTransport::SimTransport (std::shared_ptr<Pipe> pipe) :
+  m_pipe {std::move (pipe)}
+{
+}
+
+bool Simulation::SimTransport::is_open () const
+{
+  return m_pipe->open;
+}
+
+void Simulation::SimTransport::close ()
+{
+  m_pipe->open = false;
+  m_pipe->signal.cancel ();
+}
+
+asio::awaitable<std::size_t> Simulation::SimTransport::read (asio::mutable_buffer buffer, asio::error_code & ec)
+{
+  Pipe & pipe = *m_pipe;
+  while (pipe.open && ! pipe.closed && pipe.input.empty ())
+  {
+    asio::error_code ignored;
+    co_await pipe.signal.async_wait (asio::redirect_error (asio::use_awaitable, ignored));
+  }
+
+  // Fermeture par le serveur, ou coupure côté client.
+  if (! pipe.open)
+  {
+    ec = asio::error::operation_aborted;
+    co_return 0;
+  }
+  if (pipe.input.empty ())
+  {
+    ec = asio::error::eof;
+    co_return 0;
+  }
+
+  std::size_t n = asio::buffer_copy (buffer, asio::buffer (pipe.input));
+  pipe.input.erase (0, n);
+  co_return n;
+}
+
+asio::awaitable<void> Simulation::SimTransport::write (const std::vector<asio::const_buffer> & buffers, asio::error_code & ec)
+{
+  Pipe & pipe = *m_pipe;
+  if (! pipe.open)
+  {
+    ec = asio::error::broken_pipe;
+    co_return;
+  }
+
+  // Client parti : les octets sont perdus (la reprise rejouera ce qui manque).
+  if (pipe.closed)
+    co_return;
+
+  for (const asio::const_buffer & buffer : buffers)
+    pipe.simulation->receive (pipe, static_cast<const char *> (buffer.data ()), buffer.size ());
+}
+
+Simulation::Simulation (const Settings & settings) :
+  m_settings {settings},
+  m_server {0, options (settings)},
+  m_random {settings.seed},
+  m_users (settings.clients),
+  m_online {},
+  m_agenda {},
+  m_order {0},
+  m_now {0},
+  m_bytes {0},
+  m_frames {0},
+  m_connects {0},
+  m_messages {0},
+  m_privates {0},
+  m_renames {0},
+  m_drops {0},
+  m_resumed {0},
+  m_expired {0},
+  m_refused {0},
+  m_quits {0},
+  m_errors {0}
+{
+  for (std::size_t i = 0; i < m_users.size (); ++i)
+    m_users [i].alias = "u" + std::to_string (i);
+}
+
+Server::Options Simulation::options (const Settings & settings)
+{
+  // Un tampon de lecture réduit par client, ni historique, ni bilan
+  // périodique, ni débordement sur disque : rien ne dépend de l'extérieur.
+  Server::Options options;
+  options.read_buffers = settings.clients;
+  options.read_buffer_size = 256;
+  options.history = 0;
+  options.metrics_interval_ms = 0;
+  options.log_level = Log::WARNING;
+  options.mailbox_memory = static_cast<std::size_t> (-1);
+  options.mailbox_dir = std::string ();
+  options.session_seed = settings.seed;
+  return options;
+}
+
+bool Simulation::run (std::ostream & output)
+{
+  std::uint64_t allocated = allocations.load ();
+  std::clock_t begin = std::clock ();
+
+  // Montée en charge : connexions réparties au débit demandé.
+  for (std::size_t i = 0; i < m_users.size (); ++i)
+    schedule (static_cast<std::uint64_t> (i * 1000 / m_settings.connect_rate), CONNECT, i);
+
+  std::uint64_t ramp = static_cast<std::uint64_t> (m_users.size () * 1000 / m_settings.connect_rate);
+  std::uint64_t end = ramp + static_cast<std::uint64_t> (m_settings.duration * 1000);
+  while (m_now < end)
+  {
+    while (! m_agenda.empty () && m_agenda.top ().time <= m_now)
+    {
+      Scheduled event = m_agenda.top ();
+      m_agenda.pop ();
+      connect (event.user, event.action == RECONNECT);
+    }
+
+    for (std::size_t n = draw (m_settings.messages); n > 0 && ! m_online.empty (); --n, ++m_messages)
+      send (pick (), "bonjour de la simulation " + std::to_string (m_messages));
+
+    for (std::size_t n = draw (m_settings.privates); n > 0 && ! m_online.empty (); --n, ++m_privates)
+    {
+      // Destinataire quelconque, présent ou non (boîte aux lettres).
+      const User & recipient = m_users [m_random () % m_users.size ()];
+      send (pick (), "/private " + recipient.alias + " message privé " + std::to_string (m_privates));
+    }
+
+    for (std::size_t n = draw (m_settings.renames); n > 0 && ! m_online.empty (); --n, ++m_renames)
+    {
+      std::size_t user = pick ();
+      User & u = m_users [user];
+      u.alias = "u" + std::to_string (user) + "_" + std::to_string (++u.renames);
+      send (user, "/alias " + u.alias);
+    }
+
+    for (std::size_t n = draw (m_settings.drops); n > 0 && ! m_online.empty (); --n, ++m_drops)
+      drop (pick ());
+
+    for (std::size_t n = draw (m_settings.quits); n > 0 && ! m_online.empty (); --n, ++m_quits)
+      quit (pick ());
+
+    step (1);
+  }
+
+  // Fin : fenêtres et écritures en attente.
+  step (1000);
+
+  std::uint64_t cpu = static_cast<std::uint64_t> ((std::clock () - begin) * 1000.0 / CLOCKS_PER_SEC);
+  std::uint64_t allocated_count = allocations.load () - allocated;
+
+  // Mémoire résidente maximale du processus.
+  rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  // Empreinte globale : celles des clients, dans l'ordre.
+  std::uint64_t combined = 0xcbf29ce484222325ULL;
+  for (const User & user : m_users)
+    combined = (combined ^ user.digest) * 0x100000001b3ULL;
+  char digest [17];
+  std::snprintf (digest, sizeof digest, "%016llx", static_cast<unsigned long long> (combined));
+  output << "{\"seed\":" << m_settings.seed
+         << ",\"clients\":" << m_users.size ()
+         << ",\"virtual_s\":" << m_now / 1000.0
+         << ",\"online\":" << m_online.size ()
+         << ",\"connects\":" << m_connects
+         << ",\"messages\":" << m_messages
+         << ",\"privates\":" << m_privates
+         << ",\"renames\":" << m_renames
+         << ",\"drops\":" << m_drops
+         << ",\"resumed\":" << m_resumed
+         << ",\"expired\":" << m_expired
+         << ",\"refused\":" << m_refused
+         << ",\"quits\":" << m_quits
+         << ",\"errors\":" << m_errors
+         << ",\"frames\":" << m_frames
+         << ",\"bytes\":" << m_bytes
+         << ",\"digest\":\"" << digest << "\""
+         << ",\"cpu_ms\":" << cpu
+         << ",\"allocations\":" << allocated_count
+         << ",\"max_rss_kb\":" << usage.ru_maxrss
+         << "}" << std::endl;
+
+  bool passed = true;
+  if (m_refused != 0)
+  {
+    std::cerr << "sim: " << m_refused << " reprises refusées (trames manquées conservées)" << std::endl;
+    passed = false;
+  }
+  if (m_settings.max_cpu_ms != 0 && cpu > m_settings.max_cpu_ms)
+  {
+    std::cerr << "sim: temps CPU " << cpu << " ms > " << m_settings.max_cpu_ms << " ms" << std::endl;
+    passed = false;
+  }
+  if (m_settings.max_allocations != 0 && allocated_count > m_settings.max_allocations)
+  {
+    std::cerr << "sim: allocations " << allocated_count << " > " << m_settings.max_allocations << std::endl;
+    passed = false;
+  }
+  return passed;
+}
+
+bool Simulation::check_resume ()
+{
+  connect (0, false);
+  step (10);
+  drop (0);
+  step (10);
+  connect (0, true);
+  step (10);
+  return m_resumed == 1 && m_expired == 0;
+}
+
+void Simulation::step (std::uint64_t ms)
+{
+  for (std::uint64_t i = 0; i < ms; ++i)
+  {
+    VirtualClock::advance (std::chrono::milliseconds {1});
+    ++m_now;
+    if (m_server.m_context.stopped ())
+      m_server.m_context.restart ();
+    m_server.m_context.poll ();
+  }
+}
+
+void Simulation::schedule (std::uint64_t delay, Action action, std::size_t user)
+{
+  m_agenda.push (Scheduled {m_now + delay, m_order++, action, user});
+}
+
+std::size_t Simulation::draw (double rate)
+{
+  if (rate <= 0.0) return 0;
+  std::poisson_distribution<std::size_t> distribution {rate / 1000.0};
+  return distribution (m_random);
+}
+
+std::size_t Simulation::pick ()
+{
+  return m_online [m_random () % m_online.size ()];
+}
+
+void Simulation::connect (std::size_t user, bool resume)
+{
+  User & u = m_users [user];
+  if (u.state != OFFLINE && u.state != DROPPED) return;
+
+  // Nouvelle connexion : même chemin que "Server::accept".
+  u.pipe = std::make_shared<Pipe> (this, user, m_server.m_context.get_executor ());
+  m_server.m_clients.emplace_back (std::make_shared<Server::Client> (&m_server, std::make_unique<SimTransport> (u.pipe)));
+  m_server.m_clients.back ()->start ();
+  ++m_connects;
+
+  bool resuming = resume && ! u.token.empty ();
+  if (resuming)
+  {
+    // Session encore conservée (délai de grâce) : trames écrites depuis la
+    // dernière reçue.
+    u.missed = UINT64_MAX;
+    for (const Server::ClientPtr & client : m_server.m_clients)
+      if (client->token () == u.token)
+        u.missed = client->sequence () - u.frames;
+  }
+  u.state = CONNECTING;
+  send (user, resuming ? "/resume " + u.token + " " + std::to_string (u.frames) : "/session " + u.alias);
+}
+
+void Simulation::send (std::size_t user, const std::string & line)
+{
+  Pipe & pipe = *m_users [user].pipe;
+  pipe.input += line;
+  pipe.input += '\n';
+  pipe.signal.cancel ();
+}
+
+void Simulation::drop (std::size_t user)
+{
+  // Coupure : le serveur lit une fin de flux et conserve la session.
+  User & u = m_users [user];
+  offline (user);
+  u.state = DROPPED;
+  u.pipe->closed = true;
+  u.pipe->signal.cancel ();
+  schedule (100 + m_random () % 5000, RECONNECT, user);
+}
+
+void Simulation::quit (std::size_t user)
+{
+  // Départ volontaire, retour plus tard avec une nouvelle session.
+  User & u = m_users [user];
+  send (user, "/quit");
+  offline (user);
+  u.state = OFFLINE;
+  u.token.clear ();
+  u.pipe->closed = true;
+  schedule (1000 + m_random () % 10000, CONNECT, user);
+}
+
+void Simulation::online (std::size_t user)
+{
+  User & u = m_users [user];
+  if (u.state == ONLINE) return;
+  u.state = ONLINE;
+  u.slot = m_online.size ();
+  m_online.push_back (user);
+}
+
+void Simulation::offline (std::size_t user)
+{
+  User & u = m_users [user];
+  if (u.state != ONLINE) return;
+  std::size_t last = m_online.back ();
+  m_online [u.slot] = last;
+  m_users [last].slot = u.slot;
+  m_online.pop_back ();
+}
+
+void Simulation::receive (Pipe & pipe, const char * data, std::size_t size)
+{
+  m_bytes += size;
+
+  std::uint64_t & digest = m_users [pipe.user].digest;
+  for (std::size_t i = 0; i < size; ++i)
+    digest = (digest ^ static_cast<unsigned char> (data [i])) * 0x100000001b3ULL;
+
+  // Découpage en lignes ; seul le début de chacune est conservé.
+  const char * end = data + size;
+  while (data < end)
+  {
+    const char * newline = static_cast<const char *> (std::memchr (data, '\n', end - data));
+    const char * stop = newline != nullptr ? newline : end;
+    if (pipe.head.size () < HEAD)
+      pipe.head.append (data, std::min<std::size_t> (stop - data, HEAD - pipe.head.size ()));
+    if (newline == nullptr)
+      break;
+    line (pipe);
+    pipe.head.clear ();
+    data = newline + 1;
+  }
+}
+
+void Simulation::line (Pipe & pipe)
+{
+  ++m_frames;
+  User & u = m_users [pipe.user];
+  const std::string & head = pipe.head;
+
+  // Trames numérotées à partir de "#session" (reprise).
+  if (head.compare (0, 9, "#session ") == 0)
+  {
+    u.token = head.substr (9);
+    u.frames = 0;
+    return;
+  }
+  ++u.frames;
+
+  if (u.state != CONNECTING)
+    return;
+
+  if (head.compare (0, 7, "#alias ") == 0)
+    online (pipe.user);
+  else if (head.compare (0, 9, "#resumed ") == 0)
+  {
+    ++m_resumed;
+    online (pipe.user);
+  }
+  else if (head == Server::INVALID_SESSION)
+  {
+    // Session perdue (délai de grâce écoulé, trop de trames manquées) :
+    // nouvelle connexion avec le même alias. Autrement, erreur du serveur.
+    if (u.missed > m_server.m_resume_buffer)
+      ++m_expired;
+    else
+      ++m_refused;
+    u.token.clear ();
+    send (pipe.user, "/session " + u.alias);
+  }
+  else if (head.compare (0, 7, "#error ") == 0)
+    ++m_errors;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main ////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+int usage ()
+{
+  std::cerr << "Usage: sim [--seed <n>] [--clients <n>] [--connect-rate <n/s>] [--duration <s>]" << std::endl
+            << "           [--messages <n/s>] [--privates <n/s>] [--renames <n/s>] [--drops <n/s>] [--quits <n/s>]" << std::endl
+            << "           [--max-cpu-ms <ms>] [--max-allocations <n>]" << std::endl;
+  return 1;
+}
+
+int main (int argc, char * argv [])
+{
+  Simulation::Settings settings;
+
+  try
+  {
+    for (int i = 1; i < argc; i += 2)
+    {
+      std::string option {argv [i]};
+      if (i + 1 == argc)
+        return usage ();
+      else if (option == "--seed")
+        settings.seed = std::stoull (argv [i + 1]);
+      else if (option == "--clients")
+        settings.clients = std::stoul (argv [i + 1]);
+      else if (option == "--connect-rate")
+        settings.connect_rate = std::stod (argv [i + 1]);
+      else if (option == "--duration")
+        settings.duration = std::stod (argv [i + 1]);
+      else if (option == "--messages")
+        settings.messages = std::stod (argv [i + 1]);
+      else if (option == "--privates")
+        settings.privates = std::stod (argv [i + 1]);
+      else if (option == "--renames")
+        settings.renames = std::stod (argv [i + 1]);
+      else if (option == "--drops")
+        settings.drops = std::stod (argv [i + 1]);
+      else if (option == "--quits")
+        settings.quits = std::stod (argv [i + 1]);
+      else if (option == "--max-cpu-ms")
+        settings.max_cpu_ms = std::stoull (argv [i + 1]);
+      else if (option == "--max-allocations")
+        settings.max_allocations = std::stoull (argv [i + 1]);
+      else
+        return usage ();
+    }
+  }
+  catch (std::exception &)
+  {
+    return usage ();
+  }
+
+  if (settings.seed == 0 || settings.clients == 0 || settings.connect_rate <= 0.0)
+    return usage ();
+
+  // Les traces du serveur (std::cout) sont écartées, comme pour bench.
+  std::ostream output {std::cout.rdbuf ()};
+  std::cout.rdbuf (nullptr);
+
+  bool passed;
+  {
+    Simulation simulation {settings};
+    passed = simulation.run (output);
+  }
+
+  // Reprise d'une session courte, sur un serveur neuf.
+  Simulation::Settings single;
+  single.clients = 1;
+  Simulation probe {single};
+  if (! probe.check_resume ())
+  {
+    std::cerr << "sim: reprise d'une session courte refusée" << std::endl;
+    passed = false;
+  }
+  return passed ? 0 : 1;
+}
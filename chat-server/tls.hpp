@@ -0,0 +1,197 @@
+#ifndef TLS_HPP
+#define TLS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include "transport.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// TlsPool /////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Contexte TLS du serveur et fils dédiés au chiffrement : une poignée de main
+// complète (clé privée) coûte des centaines de microsecondes, et une vague de
+// reconnexions ne doit pas retarder la diffusion sur le fil principal.
+// Un io_context par fil : chaque flux TLS reste sur un seul fil (brin
+// implicite, exigé par asio::ssl::stream).
+class TlsPool
+{
+  private:
+    asio::ssl::context m_ssl;
+    std::vector<std::unique_ptr<asio::io_context>> m_contexts;
+    std::vector<asio::executor_work_guard<asio::io_context::executor_type>> m_guards;
+    std::vector<std::thread> m_threads;
+    std::size_t m_next;
+
+  public:
+    TlsPool (const std::string & certificate, const std::string & key, std::size_t threads);
+    ~TlsPool ();
+    asio::ssl::context & ssl ();
+    // Contexte du prochain flux (tour de rôle).
+    asio::io_context & next ();
+    std::vector<std::thread> & threads ();
+};
+
+inline TlsPool::TlsPool (const std::string & certificate, const std::string & key, std::size_t threads) :
+  m_ssl {asio::ssl::context::tls_server},
+  m_contexts {},
+  m_guards {},
+  m_threads {},
+  m_next {0}
+{
+  m_ssl.set_options (asio::ssl::context::default_workarounds
+                   | asio::ssl::context::no_sslv2
+                   | asio::ssl::context::no_sslv3
+                   | asio::ssl::context::no_tlsv1
+                   | asio::ssl::context::no_tlsv1_1);
+  m_ssl.use_certificate_chain_file (certificate);
+  m_ssl.use_private_key_file (key, asio::ssl::context::pem);
+
+  // Reprise de session : tickets (sans état côté serveur, clé propre au
+  // processus) et cache ; une reconnexion évite l'opération sur la clé privée.
+  SSL_CTX * native = m_ssl.native_handle ();
+  static const unsigned char ID [] = "chat";
+  SSL_CTX_set_session_id_context (native, ID, sizeof (ID) - 1);
+  SSL_CTX_set_session_cache_mode (native, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_clear_options (native, SSL_OP_NO_TICKET);
+  SSL_CTX_set_num_tickets (native, 2);
+
+  for (std::size_t i = 0; i < std::max<std::size_t> (threads, 1); ++i)
+  {
+    m_contexts.push_back (std::make_unique<asio::io_context> (1));
+    m_guards.push_back (asio::make_work_guard (*m_contexts.back ()));
+  }
+  for (auto & context : m_contexts)
+    m_threads.emplace_back ([&context] { context->run (); });
+}
+
+inline TlsPool::~TlsPool ()
+{
+  for (auto & context : m_contexts)
+    context->stop ();
+  for (std::thread & thread : m_threads)
+    thread.join ();
+}
+
+inline asio::ssl::context & TlsPool::ssl ()
+{
+  return m_ssl;
+}
+
+inline std::vector<std::thread> & TlsPool::threads ()
+{
+  return m_threads;
+}
+
+inline asio::io_context & TlsPool::next ()
+{
+  asio::io_context & context = *m_contexts [m_next];
+  m_next = (m_next + 1) % m_contexts.size ();
+  return context;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TlsTransport ////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Flux TLS sur un fil de TlsPool. La session (fil principal) attend chaque
+// opération, exécutée sur le fil du flux : poignée de main, déchiffrement et
+// chiffrement n'y occupent pas le fil principal.
+class TlsTransport : public Transport
+{
+  public:
+    typedef asio::ssl::stream<asio::ip::tcp::socket> Stream;
+    // Poignée de main abandonnée au-delà de ce délai.
+    static constexpr std::chrono::seconds HANDSHAKE_TIMEOUT {10};
+
+  private:
+    // Partagé avec les opérations en cours sur le fil du flux.
+    std::shared_ptr<Stream> m_stream;
+    bool m_open;
+
+  public:
+    // Socket accepté sur un contexte de TlsPool.
+    TlsTransport (asio::ip::tcp::socket &&, asio::ssl::context &);
+    asio::awaitable<void> handshake (asio::error_code &);
+    bool is_open () const override;
+    void close () override;
+    asio::awaitable<std::size_t> read (asio::mutable_buffer, asio::error_code &) override;
+    asio::awaitable<void> write (const std::vector<asio::const_buffer> &, asio::error_code &) override;
+
+  private:
+    // Opérations exécutées sur le fil du flux.
+    static asio::awaitable<void> handshake (std::shared_ptr<Stream>, asio::error_code &);
+    static asio::awaitable<std::size_t> read (std::shared_ptr<Stream>, asio::mutable_buffer, asio::error_code &);
+    static asio::awaitable<void> write (std::shared_ptr<Stream>, const std::vector<asio::const_buffer> &, asio::error_code &);
+};
+
+inline TlsTransport::TlsTransport (asio::ip::tcp::socket && socket, asio::ssl::context & ssl) :
+  m_stream {std::make_shared<Stream> (std::move (socket), ssl)},
+  m_open {true}
+{
+  asio::error_code ec;
+  m_stream->lowest_layer ().set_option (asio::ip::tcp::no_delay (true), ec);
+}
+
+inline asio::awaitable<void> TlsTransport::handshake (asio::error_code & ec)
+{
+  co_await asio::co_spawn (m_stream->get_executor (), handshake (m_stream, ec), asio::use_awaitable);
+}
+
+inline bool TlsTransport::is_open () const
+{
+  return m_open;
+}
+
+inline void TlsTransport::close ()
+{
+  // Fermeture sur le fil du flux (opérations éventuellement en cours).
+  m_open = false;
+  auto stream = m_stream;
+  asio::post (stream->get_executor (), [stream]
+  {
+    asio::error_code ec;
+    stream->lowest_layer ().close (ec);
+  });
+}
+
+inline asio::awaitable<std::size_t> TlsTransport::read (asio::mutable_buffer buffer, asio::error_code & ec)
+{
+  co_return co_await asio::co_spawn (m_stream->get_executor (), read (m_stream, buffer, ec), asio::use_awaitable);
+}
+
+inline asio::awaitable<void> TlsTransport::write (const std::vector<asio::const_buffer> & buffers, asio::error_code & ec)
+{
+  co_await asio::co_spawn (m_stream->get_executor (), write (m_stream, buffers, ec), asio::use_awaitable);
+}
+
+inline asio::awaitable<void> TlsTransport::handshake (std::shared_ptr<Stream> stream, asio::error_code & ec)
+{
+  // Client muet : fermeture du socket à l'échéance.
+  asio::steady_timer timer {stream->get_executor (), HANDSHAKE_TIMEOUT};
+  timer.async_wait ([stream] (const std::error_code & ec)
+  {
+    asio::error_code ignored;
+    if (! ec) stream->lowest_layer ().close (ignored);
+  });
+  co_await stream->async_handshake (Stream::server, asio::redirect_error (asio::use_awaitable, ec));
+  timer.cancel ();
+}
+
+inline asio::awaitable<std::size_t> TlsTransport::read (std::shared_ptr<Stream> stream, asio::mutable_buffer buffer, asio::error_code & ec)
+{
+  co_return co_await stream->async_read_some (buffer, asio::redirect_error (asio::use_awaitable, ec));
+}
+
+inline asio::awaitable<void> TlsTransport::write (std::shared_ptr<Stream> stream, const std::vector<asio::const_buffer> & buffers, asio::error_code & ec)
+{
+  co_await asio::async_write (*stream, buffers, asio::redirect_error (asio::use_awaitable, ec));
+}
+
+#endif // TLS_HPP
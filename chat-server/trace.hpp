@@ -0,0 +1,233 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Trace ///////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Traçage échantillonné du parcours d'un message : réception, analyse,
+// aiguillage, mise en file chez chaque destinataire, fin d'écriture.
+// Un message sur "période" reçoit un identifiant ; ses étapes sont
+// horodatées dans un anneau propre au thread (un seul producteur, sans
+// verrou) et exportées à la demande au format Chrome trace-event.
+// Traçage désactivé (période 0) : un chargement et un test par message.
+class Trace
+{
+  public:
+    enum Stage : std::uint8_t { RECEIVE, PARSE, DISPATCH, ENQUEUE, WRITE };
+
+    struct Record
+    {
+      std::uint64_t id;
+      std::uint64_t time; // nanosecondes (horloge monotone)
+      Stage stage;
+    };
+
+    // Enregistrements conservés par thread (puissance de deux).
+    static const std::size_t CAPACITY = 1 << 16;
+
+    // Message en cours de traitement par le thread (étapes sans identifiant
+    // explicite : analyse, aiguillage, mise en file).
+    class Scope
+    {
+      private:
+        std::uint64_t m_previous;
+
+      public:
+        Scope (std::uint64_t id);
+        ~Scope ();
+        Scope (const Scope &) = delete;
+        Scope & operator= (const Scope &) = delete;
+    };
+
+  private:
+    // Anneau d'un thread : écrit par son seul thread, lu par l'export.
+    struct Ring
+    {
+      std::atomic<std::uint64_t> head {0};
+      std::vector<Record> records = std::vector<Record> (CAPACITY);
+      std::uint32_t thread = 0;
+    };
+
+    static inline std::atomic<std::uint32_t> s_period {0};
+    static inline std::atomic<std::uint64_t> s_next {0};
+    static inline std::mutex s_mutex;
+    static inline std::vector<std::shared_ptr<Ring>> s_rings;
+    static inline thread_local std::uint64_t t_current = 0;
+    static inline thread_local std::uint32_t t_counter = 0;
+
+    static Ring & ring ();
+    static const char * name (Stage);
+
+  public:
+    // Un message sur "period" est tracé (0 : traçage désactivé).
+    static void enable (std::uint32_t period);
+    static bool enabled ();
+    static std::uint64_t now ();
+    // Échantillonnage d'un message reçu : identifiant, ou 0.
+    static std::uint64_t sample ();
+    static std::uint64_t current ();
+    static void record (std::uint64_t id, Stage, std::uint64_t time);
+    static void record (std::uint64_t id, Stage);
+    // Étape du message en cours, s'il est tracé.
+    static void mark (Stage);
+    // Export au format Chrome trace-event (chrome://tracing, Perfetto).
+    static void dump (std::ostream &);
+};
+
+inline Trace::Scope::Scope (std::uint64_t id) :
+  m_previous {t_current}
+{
+  t_current = id;
+}
+
+inline Trace::Scope::~Scope ()
+{
+  t_current = m_previous;
+}
+
+inline Trace::Ring & Trace::ring ()
+{
+  // Premier enregistrement du thread : création et inscription de l'anneau.
+  thread_local std::shared_ptr<Ring> ring;
+  if (ring == nullptr)
+  {
+    ring = std::make_shared<Ring> ();
+    std::lock_guard<std::mutex> lock {s_mutex};
+    ring->thread = static_cast<std::uint32_t> (s_rings.size ());
+    s_rings.push_back (ring);
+  }
+  return *ring;
+}
+
+inline const char * Trace::name (Stage stage)
+{
+  switch (stage)
+  {
+    case RECEIVE:  return "receive";
+    case PARSE:    return "parse";
+    case DISPATCH: return "dispatch";
+    case ENQUEUE:  return "enqueue";
+    case WRITE:    return "write";
+  }
+  return "?";
+}
+
+inline void Trace::enable (std::uint32_t period)
+{
+  s_period.store (period, std::memory_order_relaxed);
+}
+
+inline bool Trace::enabled ()
+{
+  return s_period.load (std::memory_order_relaxed) != 0;
+}
+
+inline std::uint64_t Trace::now ()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+inline std::uint64_t Trace::sample ()
+{
+  std::uint32_t period = s_period.load (std::memory_order_relaxed);
+  if (period == 0 || ++t_counter % period != 0) return 0;
+  return s_next.fetch_add (1, std::memory_order_relaxed) + 1;
+}
+
+inline std::uint64_t Trace::current ()
+{
+  return t_current;
+}
+
+inline void Trace::record (std::uint64_t id, Stage stage, std::uint64_t time)
+{
+  Ring & r = ring ();
+  std::uint64_t head = r.head.load (std::memory_order_relaxed);
+  r.records [head & (CAPACITY - 1)] = Record {id, time, stage};
+  r.head.store (head + 1, std::memory_order_release);
+}
+
+inline void Trace::record (std::uint64_t id, Stage stage)
+{
+  record (id, stage, now ());
+}
+
+inline void Trace::mark (Stage stage)
+{
+  if (t_current != 0)
+    record (t_current, stage);
+}
+
+inline void Trace::dump (std::ostream & out)
+{
+  // Copie des anneaux ; les enregistrements écrasés pendant la copie
+  // (l'anneau a fait un tour), ou peut-être en cours d'écriture, sont
+  // écartés.
+  std::map<std::uint64_t, std::vector<std::pair<Record, std::uint32_t>>> messages;
+  {
+    std::lock_guard<std::mutex> lock {s_mutex};
+    for (const std::shared_ptr<Ring> & r : s_rings)
+    {
+      std::uint64_t head = r->head.load (std::memory_order_acquire);
+      std::uint64_t begin = head > CAPACITY ? head - CAPACITY : 0;
+      std::vector<Record> copy;
+      for (std::uint64_t i = begin; i < head; ++i)
+        copy.push_back (r->records [i & (CAPACITY - 1)]);
+
+      // Tête relue après la copie ; l'écrivain remplit peut-être déjà la
+      // place de l'enregistrement "after", celle de "after - CAPACITY".
+      std::atomic_thread_fence (std::memory_order_acquire);
+      std::uint64_t after = r->head.load (std::memory_order_relaxed);
+      std::uint64_t valid = after + 1 > CAPACITY ? after + 1 - CAPACITY : 0;
+      for (std::uint64_t i = std::max (begin, valid); i < head; ++i)
+        messages [copy [i - begin].id].emplace_back (copy [i - begin], r->thread);
+    }
+  }
+
+  std::uint64_t origin = UINT64_MAX;
+  for (auto & message : messages)
+  {
+    std::sort (message.second.begin (), message.second.end (),
+               [] (const auto & a, const auto & b) { return a.first.time < b.first.time; });
+    origin = std::min (origin, message.second.front ().first.time);
+  }
+
+  // Un événement asynchrone par message ; chaque intervalle entre deux
+  // étapes porte le nom de l'étape qui le termine.
+  bool first = true;
+  auto event = [&] (const char * name, char phase, std::uint64_t id, std::uint64_t time, std::uint32_t thread) {
+    out << (first ? "\n" : ",\n")
+        << "{\"name\":\"" << name << "\",\"cat\":\"message\",\"ph\":\"" << phase
+        << "\",\"id\":" << id << ",\"ts\":" << (time - origin) / 1000.0
+        << ",\"pid\":1,\"tid\":" << thread << "}";
+    first = false;
+  };
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (const auto & message : messages)
+  {
+    const auto & records = message.second;
+    event ("message", 'b', message.first, records.front ().first.time, records.front ().second);
+    for (std::size_t i = 1; i < records.size (); ++i)
+    {
+      const char * stage = name (records [i].first.stage);
+      event (stage, 'b', message.first, records [i - 1].first.time, records [i].second);
+      event (stage, 'e', message.first, records [i].first.time, records [i].second);
+    }
+    event ("message", 'e', message.first, records.back ().first.time, records.back ().second);
+  }
+  out << "\n]}" << std::endl;
+}
+
+#endif // TRACE_HPP
@@ -0,0 +1,308 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <asio.hpp>
+#include "zerocopy.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// Transport ///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Flux d'octets sous une session : socket réel ou connexion en mémoire.
+// Les opérations sont des coroutines ; l'erreur est rendue par référence.
+class Transport
+{
+  public:
+    virtual ~Transport () = default;
+    virtual bool is_open () const = 0;
+    virtual void close () = 0;
+    // Lecture d'au moins un octet.
+    virtual asio::awaitable<std::size_t> read (asio::mutable_buffer, asio::error_code &) = 0;
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+    // Lecture dans un tampon enregistré (par défaut : lecture ordinaire).
+    virtual asio::awaitable<std::size_t> read (asio::mutable_registered_buffer buffer, asio::error_code & ec)
+    {
+      co_return co_await read (buffer.buffer (), ec);
+    }
+#endif
+    // Écriture complète d'une séquence de tampons.
+    virtual asio::awaitable<void> write (const std::vector<asio::const_buffer> &, asio::error_code &) = 0;
+    // Écriture de tampons qui vivent autant que "owner" : sans copie vers
+    // le noyau si le transport le permet, "owner" conservé jusqu'à la fin
+    // de la transmission (par défaut : écriture ordinaire).
+    virtual asio::awaitable<void> write (const std::vector<asio::const_buffer> & buffers, std::shared_ptr<const void> owner, asio::error_code & ec)
+    {
+      (void) owner;
+      co_await write (buffers, ec);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// StreamTransport /////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Socket de flux : TCP, ou socket Unix pour les clients de la même machine.
+// En TCP, écritures sans copie (MSG_ZEROCOPY) des tampons partagés.
+template <typename Protocol>
+class StreamTransport : public Transport
+{
+  public:
+    typedef typename Protocol::socket Socket;
+
+  private:
+    Socket m_socket;
+    // Envois sans copie en cours : état partagé avec l'attente des
+    // notifications, qui peut se terminer après la destruction du transport.
+    std::shared_ptr<ZeroCopy> m_zerocopy;
+
+    // Attente des notifications tant que des envois sont en cours.
+    void watch ();
+
+  public:
+    StreamTransport (Socket &&);
+    ~StreamTransport () override;
+    bool is_open () const override;
+    void close () override;
+    asio::awaitable<std::size_t> read (asio::mutable_buffer, asio::error_code &) override;
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+    // Lecture IORING_OP_READ_FIXED.
+    asio::awaitable<std::size_t> read (asio::mutable_registered_buffer, asio::error_code &) override;
+#endif
+    asio::awaitable<void> write (const std::vector<asio::const_buffer> &, asio::error_code &) override;
+    asio::awaitable<void> write (const std::vector<asio::const_buffer> &, std::shared_ptr<const void> owner, asio::error_code &) override;
+};
+
+typedef StreamTransport<asio::ip::tcp> SocketTransport;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+typedef StreamTransport<asio::local::stream_protocol> LocalTransport;
+#endif
+
+template <typename Protocol>
+StreamTransport<Protocol>::StreamTransport (Socket && socket) :
+  m_socket {std::move (socket)},
+  m_zerocopy {}
+{
+}
+
+template <typename Protocol>
+StreamTransport<Protocol>::~StreamTransport ()
+{
+  close ();
+}
+
+template <typename Protocol>
+bool StreamTransport<Protocol>::is_open () const
+{
+  return m_socket.is_open ();
+}
+
+template <typename Protocol>
+void StreamTransport<Protocol>::close ()
+{
+  if (m_zerocopy && m_zerocopy->attached ())
+  {
+    // Envois sans copie non confirmés : fermeture brutale, le noyau lâche
+    // les pages avant que leurs propriétaires ne soient libérés.
+    m_zerocopy->reap ();
+    asio::error_code ec;
+    if (m_zerocopy->pending () != 0 && m_socket.is_open ())
+      m_socket.set_option (asio::socket_base::linger (true, 0), ec);
+    m_zerocopy->detach ();
+  }
+
+  asio::error_code ec;
+  m_socket.close (ec);
+}
+
+template <typename Protocol>
+asio::awaitable<std::size_t> StreamTransport<Protocol>::read (asio::mutable_buffer buffer, asio::error_code & ec)
+{
+  co_return co_await m_socket.async_read_some (buffer, asio::redirect_error (asio::use_awaitable, ec));
+}
+
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+template <typename Protocol>
+asio::awaitable<std::size_t> StreamTransport<Protocol>::read (asio::mutable_registered_buffer buffer, asio::error_code & ec)
+{
+  co_return co_await m_socket.async_read_some (buffer, asio::redirect_error (asio::use_awaitable, ec));
+}
+#endif
+
+template <typename Protocol>
+asio::awaitable<void> StreamTransport<Protocol>::write (const std::vector<asio::const_buffer> & buffers, asio::error_code & ec)
+{
+  co_await asio::async_write (m_socket, buffers, asio::redirect_error (asio::use_awaitable, ec));
+}
+
+template <typename Protocol>
+asio::awaitable<void> StreamTransport<Protocol>::write (const std::vector<asio::const_buffer> & buffers, std::shared_ptr<const void> owner, asio::error_code & ec)
+{
+  if constexpr (std::is_same_v<Protocol, asio::ip::tcp>)
+  {
+    if (! m_zerocopy && m_socket.is_open ())
+      m_zerocopy = std::make_shared<ZeroCopy> (m_socket.native_handle ());
+
+    if (m_zerocopy && m_zerocopy->worthwhile ())
+    {
+      m_zerocopy->reap ();
+      std::vector<asio::const_buffer> rest {buffers};
+      std::size_t first = 0;
+      while (first < rest.size ())
+      {
+        std::ptrdiff_t n = m_zerocopy->send (rest.data () + first, rest.size () - first, owner);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+          co_await m_socket.async_wait (Socket::wait_write, asio::redirect_error (asio::use_awaitable, ec));
+          if (ec) co_return;
+          continue;
+        }
+        // Trop de notifications en attente (ENOBUFS) ou envoi impossible :
+        // la suite en écriture ordinaire.
+        if (n < 0) break;
+
+        // Tampons entièrement envoyés retirés, le suivant entamé.
+        std::size_t sent = static_cast<std::size_t> (n);
+        while (first < rest.size () && sent >= rest [first].size ())
+          sent -= rest [first++].size ();
+        if (first < rest.size ())
+          rest [first] += sent;
+      }
+      watch ();
+
+      if (first < rest.size ())
+        co_await asio::async_write (m_socket, std::vector<asio::const_buffer> (rest.begin () + first, rest.end ()),
+                                    asio::redirect_error (asio::use_awaitable, ec));
+      co_return;
+    }
+  }
+
+  (void) owner;
+  co_await write (buffers, ec);
+}
+
+template <typename Protocol>
+void StreamTransport<Protocol>::watch ()
+{
+  if (! m_zerocopy || m_zerocopy->pending () == 0 || m_zerocopy->watching ()) return;
+
+  // File d'erreurs non vide : socket signalé en erreur (EPOLLERR).
+  m_zerocopy->watching (true);
+  m_socket.async_wait (Socket::wait_error, [this, zerocopy = m_zerocopy] (const asio::error_code & ec)
+  {
+    zerocopy->watching (false);
+    if (ec || ! zerocopy->attached ()) return;
+    zerocopy->reap ();
+    watch ();
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTransport /////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Connexion en mémoire (bancs d'essai) : les lectures attendent des données
+// injectées, les écritures sont comptées et, sur demande, conservées.
+class MemoryTransport : public Transport
+{
+  private:
+    asio::steady_timer m_signal;
+    std::string m_input;
+    std::string m_output;
+    std::size_t m_written;
+    bool m_capture;
+    bool m_open;
+
+  public:
+    MemoryTransport (asio::any_io_executor, bool capture = false);
+    // Données reçues par le serveur.
+    void inject (const std::string &);
+    // Données envoyées par le serveur depuis le dernier appel.
+    std::string take ();
+    std::size_t written () const;
+
+    bool is_open () const override;
+    void close () override;
+    asio::awaitable<std::size_t> read (asio::mutable_buffer, asio::error_code &) override;
+    asio::awaitable<void> write (const std::vector<asio::const_buffer> &, asio::error_code &) override;
+};
+
+inline MemoryTransport::MemoryTransport (asio::any_io_executor executor, bool capture) :
+  m_signal {executor, asio::steady_timer::time_point::max ()},
+  m_input {},
+  m_output {},
+  m_written {0},
+  m_capture {capture},
+  m_open {true}
+{
+}
+
+inline void MemoryTransport::inject (const std::string & data)
+{
+  m_input += data;
+  m_signal.cancel ();
+}
+
+inline std::string MemoryTransport::take ()
+{
+  std::string output;
+  output.swap (m_output);
+  return output;
+}
+
+inline std::size_t MemoryTransport::written () const
+{
+  return m_written;
+}
+
+inline bool MemoryTransport::is_open () const
+{
+  return m_open;
+}
+
+inline void MemoryTransport::close ()
+{
+  m_open = false;
+  m_signal.cancel ();
+}
+
+inline asio::awaitable<std::size_t> MemoryTransport::read (asio::mutable_buffer buffer, asio::error_code & ec)
+{
+  // Attente de données injectées (ou de la fermeture).
+  while (m_open && m_input.empty ())
+  {
+    asio::error_code ignored;
+    co_await m_signal.async_wait (asio::redirect_error (asio::use_awaitable, ignored));
+  }
+
+  if (! m_open)
+  {
+    ec = asio::error::operation_aborted;
+    co_return 0;
+  }
+
+  std::size_t n = asio::buffer_copy (buffer, asio::buffer (m_input));
+  m_input.erase (0, n);
+  co_return n;
+}
+
+inline asio::awaitable<void> MemoryTransport::write (const std::vector<asio::const_buffer> & buffers, asio::error_code & ec)
+{
+  if (! m_open)
+  {
+    ec = asio::error::broken_pipe;
+    co_return;
+  }
+
+  for (const asio::const_buffer & buffer : buffers)
+  {
+    m_written += buffer.size ();
+    if (m_capture)
+      m_output.append (static_cast<const char *> (buffer.data ()), buffer.size ());
+  }
+}
+
+#endif // TRANSPORT_HPP
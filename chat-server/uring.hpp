@@ -0,0 +1,160 @@
+#ifndef URING_HPP
+#define URING_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <asio.hpp>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// io_uring ////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Le backend est choisi à la compilation par ASIO : ASIO_HAS_IO_URING et
+// ASIO_DISABLE_EPOLL remplacent le réacteur epoll par io_uring pour les
+// sockets (cible "server-uring" du Makefile).
+inline const char * io_backend ()
+{
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+  return "io_uring";
+#elif defined(__linux__)
+  return "epoll";
+#else
+  return "select/iocp";
+#endif
+}
+
+// Le noyau accepte-t-il io_uring et les opérations utilisées par ASIO ?
+// Sondage par appels système directs, sans dépendre de liburing : un noyau
+// trop ancien, ou un filtre seccomp (conteneurs), fait échouer la création
+// de l'anneau.
+inline bool io_uring_available ()
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+  io_uring_params params {};
+  int fd = static_cast<int> (::syscall (__NR_io_uring_setup, 4, &params));
+  if (fd < 0) return false;
+
+  std::vector<char> memory (sizeof (io_uring_probe) + IORING_OP_LAST * sizeof (io_uring_probe_op), 0);
+  io_uring_probe * probe = reinterpret_cast<io_uring_probe *> (memory.data ());
+  long r = ::syscall (__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST);
+  ::close (fd);
+  if (r < 0) return false;
+
+  for (int op : {IORING_OP_ACCEPT, IORING_OP_RECVMSG, IORING_OP_SENDMSG, IORING_OP_READ_FIXED,
+                 IORING_OP_POLL_ADD, IORING_OP_TIMEOUT, IORING_OP_ASYNC_CANCEL})
+    if (op > probe->last_op || ! (probe->ops [op].flags & IO_URING_OP_SUPPORTED))
+      return false;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ReadBuffers /////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Tampons de lecture de taille fixe, découpés dans une seule zone mémoire.
+// Avec io_uring, la zone est enregistrée auprès du noyau une fois pour toutes :
+// une lecture dans un tampon enregistré devient un IORING_OP_READ_FIXED, sans
+// épinglage des pages à chaque opération.
+class ReadBuffers
+{
+  public:
+    static const std::size_t NONE = static_cast<std::size_t> (-1);
+
+  private:
+    std::size_t m_size;
+    std::vector<char> m_memory;
+    std::vector<std::size_t> m_free;
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+    std::vector<asio::mutable_buffer> m_buffers;
+    std::unique_ptr<asio::buffer_registration<std::vector<asio::mutable_buffer>>> m_registration;
+#endif
+
+  public:
+    ReadBuffers (asio::io_context &, std::size_t count, std::size_t size);
+    std::size_t size () const;
+    // Emprunt d'un tampon (NONE si tous sont utilisés).
+    std::size_t acquire ();
+    void release (std::size_t);
+    asio::mutable_buffer buffer (std::size_t);
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+    bool registered () const;
+    asio::mutable_registered_buffer registered (std::size_t);
+#endif
+};
+
+inline ReadBuffers::ReadBuffers (asio::io_context & context, std::size_t count, std::size_t size) :
+  m_size {size},
+  m_memory (count * size),
+  m_free ()
+{
+  m_free.reserve (count);
+  for (std::size_t i = count; i-- > 0; )
+    m_free.push_back (i);
+
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+  for (std::size_t i = 0; i < count; ++i)
+    m_buffers.push_back (asio::buffer (m_memory.data () + i * size, size));
+
+  // Le nombre de tampons enregistrables est limité par le noyau : en cas
+  // d'échec, les lectures se font sans enregistrement.
+  try
+  {
+    if (count != 0)
+      m_registration.reset (new asio::buffer_registration<std::vector<asio::mutable_buffer>> (asio::register_buffers (context, m_buffers)));
+  }
+  catch (std::exception &)
+  {
+  }
+#else
+  (void) context;
+#endif
+}
+
+inline std::size_t ReadBuffers::size () const
+{
+  return m_size;
+}
+
+inline std::size_t ReadBuffers::acquire ()
+{
+  if (m_free.empty ()) return NONE;
+  std::size_t slot = m_free.back ();
+  m_free.pop_back ();
+  return slot;
+}
+
+inline void ReadBuffers::release (std::size_t slot)
+{
+  if (slot != NONE)
+    m_free.push_back (slot);
+}
+
+inline asio::mutable_buffer ReadBuffers::buffer (std::size_t slot)
+{
+  return asio::buffer (m_memory.data () + slot * m_size, m_size);
+}
+
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+inline bool ReadBuffers::registered () const
+{
+  return m_registration != nullptr;
+}
+
+inline asio::mutable_registered_buffer ReadBuffers::registered (std::size_t slot)
+{
+  return (*m_registration) [slot];
+}
+#endif
+
+#endif // URING_HPP
@@ -0,0 +1,196 @@
+#ifndef ZEROCOPY_HPP
+#define ZEROCOPY_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <asio.hpp>
+
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define CHAT_HAS_ZEROCOPY 1
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// ZeroCopy ////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Envois sans copie d'un socket TCP (Linux, MSG_ZEROCOPY) : le noyau
+// transmet les pages de l'application au lieu de les copier, elles ne
+// doivent donc pas changer avant la notification de fin, lue dans la file
+// d'erreurs du socket. Chaque envoi garde son propriétaire ("owner", le
+// message partagé) jusqu'à cette notification. Épinglage des pages et
+// notification ont un coût fixe : rentable pour de gros envois seulement
+// (seuil : bench.exe --filter zerocopy/). Sans carte réseau (boucle
+// locale), le noyau copie quand même et le signale ("copied").
+class ZeroCopy
+{
+  private:
+    int m_fd;
+    bool m_enabled;
+    bool m_watching;
+    // Numéro du prochain envoi (compté par le noyau, envois réussis
+    // seulement) ; propriétaires par dernier numéro, dans l'ordre.
+    std::uint32_t m_next;
+    std::deque<std::pair<std::uint32_t, std::shared_ptr<const void>>> m_pending;
+    // Notifications "copié" consécutives.
+    std::uint32_t m_copied;
+
+  public:
+    // Bilan (thread du serveur) : envois, notifications, envois copiés.
+    static inline std::uint64_t s_sends = 0;
+    static inline std::uint64_t s_completions = 0;
+    static inline std::uint64_t s_copied = 0;
+
+    // Activation sur le socket (SO_ZEROCOPY) ; échec : enabled () faux.
+    explicit ZeroCopy (int fd);
+    bool enabled () const;
+    // Vrai tant que le noyau ne copie pas systématiquement.
+    bool worthwhile () const;
+    // Envoi non bloquant de "count" tampons (sendmsg) : octets acceptés, ou
+    // -1 et errno (EAGAIN : socket plein ; ENOBUFS : trop de notifications
+    // en attente).
+    std::ptrdiff_t send (const asio::const_buffer * buffers, std::size_t count, const std::shared_ptr<const void> & owner);
+    // Lecture des notifications disponibles : propriétaires libérés.
+    void reap ();
+    std::size_t pending () const;
+    // Attente des notifications en cours ; socket fermé (propriétaires
+    // libérés, l'attente ne doit plus toucher au transport).
+    bool watching () const;
+    void watching (bool);
+    bool attached () const;
+    void detach ();
+
+  private:
+    // Au-delà, le noyau copie : envois ordinaires.
+    static constexpr std::uint32_t COPIED_LIMIT = 8;
+};
+
+inline ZeroCopy::ZeroCopy (int fd) :
+  m_fd {fd},
+  m_enabled {false},
+  m_watching {false},
+  m_next {0},
+  m_pending {},
+  m_copied {0}
+{
+#if defined(CHAT_HAS_ZEROCOPY)
+  int one = 1;
+  m_enabled = ::setsockopt (fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof (one)) == 0;
+#endif
+}
+
+inline bool ZeroCopy::enabled () const
+{
+  return m_enabled;
+}
+
+inline bool ZeroCopy::worthwhile () const
+{
+  return m_enabled && m_copied < COPIED_LIMIT;
+}
+
+inline std::ptrdiff_t ZeroCopy::send (const asio::const_buffer * buffers, std::size_t count, const std::shared_ptr<const void> & owner)
+{
+#if defined(CHAT_HAS_ZEROCOPY)
+  iovec vectors [16];
+  count = std::min<std::size_t> (count, 16);
+  for (std::size_t i = 0; i < count; ++i)
+    vectors [i] = iovec {const_cast<void *> (buffers [i].data ()), buffers [i].size ()};
+
+  msghdr message {};
+  message.msg_iov = vectors;
+  message.msg_iovlen = count;
+  ssize_t n = ::sendmsg (m_fd, &message, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (n < 0) return -1;
+
+  // Envois consécutifs d'un même propriétaire : une seule entrée.
+  if (! m_pending.empty () && m_pending.back ().second == owner)
+    m_pending.back ().first = m_next;
+  else
+    m_pending.emplace_back (m_next, owner);
+  ++m_next;
+  ++s_sends;
+  return n;
+#else
+  (void) buffers;
+  (void) count;
+  (void) owner;
+  errno = EOPNOTSUPP;
+  return -1;
+#endif
+}
+
+inline void ZeroCopy::reap ()
+{
+#if defined(CHAT_HAS_ZEROCOPY)
+  for (;;)
+  {
+    char control [128];
+    msghdr message {};
+    message.msg_control = control;
+    message.msg_controllen = sizeof (control);
+    if (::recvmsg (m_fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+
+    for (cmsghdr * header = CMSG_FIRSTHDR (&message); header != nullptr; header = CMSG_NXTHDR (&message, header))
+    {
+      if (! (header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR)
+          && ! (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR))
+        continue;
+      const sock_extended_err * error = reinterpret_cast<const sock_extended_err *> (CMSG_DATA (header));
+      if (error->ee_origin != SO_EE_ORIGIN_ZEROCOPY || error->ee_errno != 0) continue;
+
+      // Envois [ee_info, ee_data] terminés ; TCP les termine dans l'ordre
+      // (numéros sur 32 bits, comparés modulo 2^32).
+      while (! m_pending.empty () && static_cast<std::int32_t> (m_pending.front ().first - error->ee_data) <= 0)
+        m_pending.pop_front ();
+
+      ++s_completions;
+      if (error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+      {
+        ++s_copied;
+        ++m_copied;
+      }
+      else
+        m_copied = 0;
+    }
+  }
+#endif
+}
+
+inline std::size_t ZeroCopy::pending () const
+{
+  return m_pending.size ();
+}
+
+inline bool ZeroCopy::watching () const
+{
+  return m_watching;
+}
+
+inline void ZeroCopy::watching (bool watching)
+{
+  m_watching = watching;
+}
+
+inline bool ZeroCopy::attached () const
+{
+  return m_fd >= 0;
+}
+
+inline void ZeroCopy::detach ()
+{
+  m_fd = -1;
+  m_pending.clear ();
+}
+
+#endif // ZEROCOPY_HPP